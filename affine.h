@@ -0,0 +1,165 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+#include "thread_state.h"
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>  // std::uintptr_t
+#include <utility>
+
+namespace detail {
+
+// Destruction posted to a thread's mailbox; intrusive, so posting never allocates
+struct MailboxEntry {
+    using Run = void (*)(MailboxEntry*) noexcept;
+
+    MailboxEntry* next_posted = nullptr;
+    Run run = nullptr;
+};
+
+}  // namespace detail
+
+// Destructions that must run on one particular thread. Other threads post to it lock-free; the
+// thread runs them when it calls `Poll()`, and runs whatever is left when it exits. Posts that
+// arrive after that fail, and the poster runs the destruction itself.
+class ThreadMailbox {
+public:
+    // Null once the thread is past destroying its thread-locals
+    static ThreadMailbox* Current() noexcept {
+        Holder* holder = detail::ThreadLocal<Holder>();
+        return holder ? holder->mailbox : nullptr;
+    }
+    // Does not create a mailbox for the calling thread
+    static bool IsCurrent(const ThreadMailbox* mailbox) noexcept {
+        return current_ == mailbox;
+    }
+
+    // Runs what was posted to the calling thread; returns how many
+    static size_t Poll() noexcept {
+        ThreadMailbox* mailbox = Current();
+        if (!mailbox) {
+            return 0;
+        }
+        return RunAll(mailbox->posted_.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    void Retain() noexcept {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    void Release() noexcept {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    // Returns false once the thread has exited
+    bool Post(detail::MailboxEntry* entry) noexcept {
+        detail::MailboxEntry* head = posted_.load(std::memory_order_acquire);
+        do {
+            if (head == Closed()) {
+                return false;
+            }
+            entry->next_posted = head;
+        } while (!posted_.compare_exchange_weak(head, entry, std::memory_order_acq_rel,
+                                                std::memory_order_acquire));
+        return true;
+    }
+
+private:
+    struct Holder {
+        Holder() : mailbox(new ThreadMailbox) {
+            current_ = mailbox;
+        }
+        ~Holder() {
+            RunAll(mailbox->posted_.exchange(Closed(), std::memory_order_acq_rel));
+            current_ = nullptr;
+            mailbox->Release();
+        }
+        ThreadMailbox* mailbox;
+    };
+
+    static detail::MailboxEntry* Closed() noexcept {
+        return reinterpret_cast<detail::MailboxEntry*>(std::uintptr_t{1});
+    }
+
+    // The stack holds the newest post first; run them in the order they were posted
+    static size_t RunAll(detail::MailboxEntry* head) noexcept {
+        detail::MailboxEntry* ordered = nullptr;
+        size_t count = 0;
+        while (head) {
+            detail::MailboxEntry* next = head->next_posted;
+            head->next_posted = ordered;
+            ordered = head;
+            head = next;
+            ++count;
+        }
+        while (ordered) {
+            // Running may free the entry, so step past it first
+            detail::MailboxEntry* next = ordered->next_posted;
+            ordered->run(ordered);
+            ordered = next;
+        }
+        return count;
+    }
+
+    static inline thread_local ThreadMailbox* current_ = nullptr;
+
+    std::atomic<detail::MailboxEntry*> posted_ = nullptr;
+    std::atomic<size_t> refs_ = 1;
+};
+
+// `MakeShared` block that remembers its creating thread and destroys its object there. A final
+// release elsewhere takes a weak reference and posts the destruction to the home thread's
+// mailbox, so the block is freed by whoever finishes last. A block made while its thread is exiting
+// has no home, and its object is destroyed wherever the last reference goes.
+template <typename T, typename Counting>
+struct ControlBlockAffine : ControlBlockMakeShared<T, Counting>, detail::MailboxEntry {
+    ControlBlockAffine()
+        : ControlBlockMakeShared<T, Counting>(HookOf<&Manage>()),
+          home_(ThreadMailbox::Current()) {
+        if (home_) {
+            home_->Retain();
+        }
+        run = &Destroy;
+    }
+
+    static void Manage(ControlBlockBase<Counting>* base, BlockOp op) noexcept {
+        auto* self = static_cast<ControlBlockAffine*>(base);
+        if (op == BlockOp::kDestroyObject) {
+            if (!self->home_ || ThreadMailbox::IsCurrent(self->home_)) {
+                self->Object()->~T();
+                return;
+            }
+            self->IncrWeakCount();
+            if (!self->home_->Post(self)) {
+                // The home thread is gone
+                Destroy(self);
+            }
+        } else {
+            if (self->home_) {
+                self->home_->Release();
+            }
+            delete self;
+        }
+    }
+
+    static void Destroy(detail::MailboxEntry* entry) noexcept {
+        auto* self = static_cast<ControlBlockAffine*>(entry);
+        self->Object()->~T();
+        self->DecrWeakCount();
+    }
+
+    ThreadMailbox* home_;
+};
+
+// Same as `MakeShared`, but the object is destroyed on the calling thread, which has to call
+// `ThreadMailbox::Poll()` now and then to run destructions released elsewhere
+template <typename T, typename Counting = AtomicCounting, typename... Args>
+SharedPtr<T, Counting> MakeSharedAffine(Args&&... args) {
+    static_assert(!kHasMainReference<Counting>, "use MakeReadMostly");
+    auto* block = new ControlBlockAffine<T, Counting>;
+    return detail::AdoptShared<T, Counting>(block,
+                                            new (block->Object()) T(std::forward<Args>(args)...));
+}
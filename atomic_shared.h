@@ -0,0 +1,342 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+#include "weak.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>  // uint64_t, std::intptr_t, std::uintptr_t
+#include <thread>
+#include <utility>
+
+namespace detail {
+
+// Slot holding a `SharedPtr` or `WeakPtr` that can be read and replaced concurrently.
+//
+// Each stored value lives in an immutable node, and the slot is a single word holding the node
+// pointer in its low 48 bits and a local count in the high 16. A reader pins the node with one
+// fetch_add on the slot, uses the value in place and returns the pin with a CAS. A writer that
+// swaps the node out moves the local count it observed into the node's own count, so readers
+// that lose the race drop their pin there instead. Reads are lock-free; writes allocate a node.
+//
+// The local count has 16 bits, and waiters keep their pin while they sleep. Past `kPinLimit`
+// pins, a reader hands its pin back and yields until some drain, so the count only overflows if
+// more than 32768 threads race for a pin at once.
+template <typename Value>
+class AtomicSlot {
+public:
+    AtomicSlot() noexcept : word_(0) {
+    }
+    explicit AtomicSlot(Value desired) : word_(Pack(MakeNode(std::move(desired)))) {
+    }
+
+    AtomicSlot(const AtomicSlot&) = delete;
+    AtomicSlot& operator=(const AtomicSlot&) = delete;
+
+    ~AtomicSlot() {
+        Retire(word_.load(std::memory_order_acquire));
+    }
+
+    // Calls `f` on the stored value (an empty one if there is none) while it is pinned
+    template <typename F>
+    auto Visit(F&& f) const {
+        Node* node = Pin();
+        if (!node) {
+            return f(Value());
+        }
+        auto result = f(static_cast<const Value&>(node->value));
+        Unpin(node);
+        return result;
+    }
+
+    Value Exchange(Value desired) {
+        Node* fresh = MakeNode(std::move(desired));
+        return Retire(word_.exchange(Pack(fresh), std::memory_order_acq_rel));
+    }
+
+    // `expected` matches when it holds the same pointer and the same control block as the stored
+    // value; on failure it receives the stored value
+    bool CompareExchangeStrong(Value& expected, Value desired) {
+        Node* fresh = nullptr;
+        while (true) {
+            switch (TryCompareExchange(expected, desired, fresh)) {
+                case Outcome::kExchanged:
+                    return true;
+                case Outcome::kMismatch:
+                    delete fresh;
+                    return false;
+                case Outcome::kRaced:
+                    break;
+            }
+        }
+    }
+
+    // May also fail when the slot changed to an equivalent value mid-way
+    bool CompareExchangeWeak(Value& expected, Value desired) {
+        Node* fresh = nullptr;
+        switch (TryCompareExchange(expected, desired, fresh)) {
+            case Outcome::kExchanged:
+                return true;
+            case Outcome::kMismatch:
+                delete fresh;
+                return false;
+            case Outcome::kRaced:
+                delete fresh;
+                expected = Visit([](const Value& value) { return value; });
+                return false;
+        }
+        return false;
+    }
+
+    // Blocks while the slot holds a value equivalent to `old`. The node stays pinned meanwhile, so
+    // it can't be freed and reused at the same address; any store replaces the node and wakes us.
+    void Wait(const Value& old) const {
+        while (true) {
+            Node* node = Pin();
+            const Value empty;
+            const bool same = Equivalent(node ? node->value : empty, old);
+            if (same) {
+                uint64_t word = word_.load(std::memory_order_acquire);
+                while (NodeOf(word) == node) {
+                    word_.wait(word, std::memory_order_acquire);
+                    word = word_.load(std::memory_order_acquire);
+                }
+            }
+            if (node) {
+                Unpin(node);
+            }
+            if (!same) {
+                return;
+            }
+        }
+    }
+    void NotifyOne() noexcept {
+        word_.notify_one();
+    }
+    void NotifyAll() noexcept {
+        word_.notify_all();
+    }
+
+    bool IsLockFree() const noexcept {
+        return word_.is_lock_free();
+    }
+
+private:
+    struct Node {
+        explicit Node(Value desired) : value(std::move(desired)) {
+        }
+
+        // Holders of the node other than the slot; pins moved in by a writer make it positive,
+        // readers that lose the race may take it negative first
+        std::atomic<std::intptr_t> refs = 0;
+        // Only read while the node is reachable
+        Value value;
+    };
+
+    enum class Outcome { kExchanged, kMismatch, kRaced };
+
+    static_assert(sizeof(void*) == 8, "AtomicSlot packs pointers into 48 bits");
+
+    static constexpr uint64_t kPtrMask = (uint64_t{1} << 48) - 1;
+    static constexpr uint64_t kLocalOne = uint64_t{1} << 48;
+    static constexpr std::intptr_t kPinLimit = std::intptr_t{1} << 15;
+
+    static uint64_t Pack(Node* node) noexcept {
+        return reinterpret_cast<std::uintptr_t>(node);
+    }
+    static Node* NodeOf(uint64_t word) noexcept {
+        return reinterpret_cast<Node*>(static_cast<std::uintptr_t>(word & kPtrMask));
+    }
+    static std::intptr_t Local(uint64_t word) noexcept {
+        return static_cast<std::intptr_t>(word >> 48);
+    }
+
+    static Node* MakeNode(Value desired) {
+        return desired.p_ctrl_block_ ? new Node(std::move(desired)) : nullptr;
+    }
+
+    static bool Equivalent(const Value& left, const Value& right) noexcept {
+        return left.p_ctrl_block_ == right.p_ctrl_block_ && left.raw_ptr_ == right.raw_ptr_;
+    }
+
+    // An empty slot is read without pinning. A pin that still lands on an empty word is left
+    // there: the next store resets the local count.
+    Node* Pin() const noexcept {
+        while (true) {
+            if (!NodeOf(word_.load(std::memory_order_relaxed))) {
+                return nullptr;
+            }
+            const uint64_t word = word_.fetch_add(kLocalOne, std::memory_order_acquire);
+            assert(Local(word) != 0xffff && "AtomicSlot pin count overflowed");
+            Node* node = NodeOf(word);
+            if (!node || Local(word) < kPinLimit) {
+                return node;
+            }
+            // Too many pins are held already; give ours back and let some of them drain
+            Unpin(node);
+            std::this_thread::yield();
+        }
+    }
+
+    // The node can't be freed and reused while pinned, so comparing pointers is ABA-free
+    void Unpin(Node* node) const noexcept {
+        uint64_t word = word_.load(std::memory_order_relaxed);
+        while (NodeOf(word) == node) {
+            if (word_.compare_exchange_weak(word, word - kLocalOne, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        // A writer swapped the node out and moved our pin into `refs`
+        Unref(node);
+    }
+
+    static void Unref(Node* node) noexcept {
+        if (node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete node;
+        }
+    }
+
+    // Takes ownership of a word swapped out of the slot and returns its value
+    static Value Retire(uint64_t word) {
+        Node* node = NodeOf(word);
+        if (!node) {
+            return Value();
+        }
+        const std::intptr_t pins = Local(word);
+        if (node->refs.fetch_add(pins + 1, std::memory_order_acq_rel) == -pins) {
+            // Every reader is done with it
+            Value result = std::move(node->value);
+            delete node;
+            return result;
+        }
+        Value result = node->value;
+        Unref(node);
+        return result;
+    }
+
+    // `fresh` is allocated on the first matching attempt and kept across retries
+    Outcome TryCompareExchange(Value& expected, Value& desired, Node*& fresh) {
+        Node* node = Pin();
+        const Value empty;
+        const Value& current = node ? node->value : empty;
+        if (!Equivalent(current, expected)) {
+            expected = current;
+            if (node) {
+                Unpin(node);
+            }
+            return Outcome::kMismatch;
+        }
+        if (!fresh) {
+            fresh = MakeNode(std::move(desired));
+        }
+        uint64_t word = word_.load(std::memory_order_relaxed);
+        while (NodeOf(word) == node) {
+            if (word_.compare_exchange_weak(word, Pack(fresh), std::memory_order_acq_rel,
+                                            std::memory_order_relaxed)) {
+                Retire(word);
+                if (node) {
+                    Unref(node);
+                }
+                return Outcome::kExchanged;
+            }
+        }
+        if (node) {
+            Unref(node);
+        }
+        return Outcome::kRaced;
+    }
+
+    mutable std::atomic<uint64_t> word_;
+};
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// `SharedPtr` slot
+
+template <typename T, typename Counting = AtomicCounting>
+class AtomicSharedPtr {
+public:
+    AtomicSharedPtr() noexcept = default;
+    AtomicSharedPtr(SharedPtr<T, Counting> desired) : slot_(std::move(desired)) {
+    }
+
+    SharedPtr<T, Counting> Load() const {
+        return slot_.Visit([](const SharedPtr<T, Counting>& value) { return value; });
+    }
+    void Store(SharedPtr<T, Counting> desired) {
+        slot_.Exchange(std::move(desired));
+    }
+    SharedPtr<T, Counting> Exchange(SharedPtr<T, Counting> desired) {
+        return slot_.Exchange(std::move(desired));
+    }
+
+    bool CompareExchangeStrong(SharedPtr<T, Counting>& expected, SharedPtr<T, Counting> desired) {
+        return slot_.CompareExchangeStrong(expected, std::move(desired));
+    }
+    bool CompareExchangeWeak(SharedPtr<T, Counting>& expected, SharedPtr<T, Counting> desired) {
+        return slot_.CompareExchangeWeak(expected, std::move(desired));
+    }
+
+    // Waits for a store that replaces `old`; the writer wakes waiters with `NotifyOne()` or
+    // `NotifyAll()` after storing (futex-backed `std::atomic::wait` on the slot word)
+    void Wait(const SharedPtr<T, Counting>& old) const {
+        slot_.Wait(old);
+    }
+    void NotifyOne() noexcept {
+        slot_.NotifyOne();
+    }
+    void NotifyAll() noexcept {
+        slot_.NotifyAll();
+    }
+
+    bool IsLockFree() const noexcept {
+        return slot_.IsLockFree();
+    }
+
+private:
+    detail::AtomicSlot<SharedPtr<T, Counting>> slot_;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// `WeakPtr` slot
+
+template <typename T, typename Counting = AtomicCounting>
+class AtomicWeakPtr {
+public:
+    AtomicWeakPtr() noexcept = default;
+    AtomicWeakPtr(WeakPtr<T, Counting> desired) : slot_(std::move(desired)) {
+    }
+
+    WeakPtr<T, Counting> Load() const {
+        return slot_.Visit([](const WeakPtr<T, Counting>& value) { return value; });
+    }
+    void Store(WeakPtr<T, Counting> desired) {
+        slot_.Exchange(std::move(desired));
+    }
+    WeakPtr<T, Counting> Exchange(WeakPtr<T, Counting> desired) {
+        return slot_.Exchange(std::move(desired));
+    }
+
+    bool CompareExchangeStrong(WeakPtr<T, Counting>& expected, WeakPtr<T, Counting> desired) {
+        return slot_.CompareExchangeStrong(expected, std::move(desired));
+    }
+    bool CompareExchangeWeak(WeakPtr<T, Counting>& expected, WeakPtr<T, Counting> desired) {
+        return slot_.CompareExchangeWeak(expected, std::move(desired));
+    }
+
+    // Promotes the stored pointer in place, without copying the `WeakPtr` out first; empty if
+    // the slot is empty or the object is gone
+    SharedPtr<T, Counting> LoadAndLock() const noexcept {
+        return slot_.Visit([](const WeakPtr<T, Counting>& value) { return value.TryLock(); });
+    }
+
+    bool IsLockFree() const noexcept {
+        return slot_.IsLockFree();
+    }
+
+private:
+    detail::AtomicSlot<WeakPtr<T, Counting>> slot_;
+};
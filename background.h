@@ -0,0 +1,180 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+#include "bounded_queue.h"
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <thread>
+#include <utility>
+
+// Thread that runs destructors handed to it, so dropping the last reference to a large object
+// costs the releasing thread one queue push. The queue is a bounded lock-free ring; a producer
+// that finds it full waits for the reclaimer to catch up, and destructors that release more
+// objects on the reclaimer thread run inline.
+//
+// Objects still in flight when the reclaimer is destroyed are destroyed before it returns.
+class BackgroundReclaimer {
+public:
+    using Destroy = void (*)(void*) noexcept;
+
+    explicit BackgroundReclaimer(size_t capacity = 4096) : queue_(capacity) {
+        thread_ = std::thread([this] { Run(); });
+    }
+
+    BackgroundReclaimer(const BackgroundReclaimer&) = delete;
+    BackgroundReclaimer& operator=(const BackgroundReclaimer&) = delete;
+
+    ~BackgroundReclaimer() {
+        stop_.store(true, std::memory_order_seq_cst);
+        pushed_.fetch_add(1, std::memory_order_seq_cst);
+        pushed_.notify_one();
+        thread_.join();
+    }
+
+    // Lives as long as the program, so objects may be released during static destruction; what
+    // is still queued at exit is not destroyed, so callers that need it call `Drain()` first
+    static BackgroundReclaimer& Default() {
+        static auto* reclaimer = new BackgroundReclaimer;
+        return *reclaimer;
+    }
+
+    // Runs `destroy(object)` on the reclaimer thread
+    void Push(void* object, Destroy destroy) noexcept {
+        if (current_ == this) {
+            destroy(object);
+            return;
+        }
+        // Read before each attempt, so a cell freed after a failed push wakes the wait
+        size_t done = done_.load(std::memory_order_seq_cst);
+        while (!queue_.TryPush(Task{object, destroy})) {
+            // Backpressure: wait for the reclaimer to free a cell
+            WaitDone(done);
+            done = done_.load(std::memory_order_seq_cst);
+        }
+        pushed_.fetch_add(1, std::memory_order_seq_cst);
+        pushed_.notify_one();
+    }
+
+    // Waits until everything pushed before the call has been destroyed
+    void Drain() noexcept {
+        if (current_ == this) {
+            return;
+        }
+        const size_t target = queue_.Claimed();
+        size_t done = done_.load(std::memory_order_seq_cst);
+        while (done < target) {
+            WaitDone(done);
+            done = done_.load(std::memory_order_seq_cst);
+        }
+    }
+
+    // Builds `T` in a `MakeShared` block whose object is destroyed by this reclaimer
+    template <typename T, typename Counting = AtomicCounting, typename... Args>
+    SharedPtr<T, Counting> MakeShared(Args&&... args);
+
+private:
+    struct Task {
+        void* object;
+        Destroy destroy;
+    };
+
+    void WaitDone(size_t done) noexcept {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        done_.wait(done, std::memory_order_seq_cst);
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void Run() noexcept {
+        current_ = this;
+        while (true) {
+            const size_t pushed = pushed_.load(std::memory_order_seq_cst);
+            Task task;
+            if (queue_.TryPop(task)) {
+                task.destroy(task.object);
+                done_.fetch_add(1, std::memory_order_seq_cst);
+                if (waiters_.load(std::memory_order_seq_cst) > 0) {
+                    done_.notify_all();
+                }
+                continue;
+            }
+            if (stop_.load(std::memory_order_seq_cst)) {
+                if (done_.load(std::memory_order_relaxed) == queue_.Claimed()) {
+                    return;
+                }
+                // A producer has claimed a cell but not filled it yet
+                std::this_thread::yield();
+                continue;
+            }
+            pushed_.wait(pushed, std::memory_order_seq_cst);
+        }
+    }
+
+    static inline thread_local BackgroundReclaimer* current_ = nullptr;
+
+    detail::BoundedQueue<Task> queue_;
+    alignas(kCacheLineSize) std::atomic<size_t> done_ = 0;
+    std::atomic<size_t> waiters_ = 0;
+    alignas(kCacheLineSize) std::atomic<size_t> pushed_ = 0;
+    std::atomic<bool> stop_ = false;
+    std::thread thread_;
+};
+
+// `MakeShared` block that hands the destruction of its object to a reclaimer; it keeps a weak
+// reference meanwhile, so the block is freed by whoever finishes last
+template <typename T, typename Counting>
+struct ControlBlockBackground : ControlBlockMakeShared<T, Counting> {
+    explicit ControlBlockBackground(BackgroundReclaimer& reclaimer)
+        : ControlBlockMakeShared<T, Counting>(HookOf<&Manage>()), reclaimer_(reclaimer) {
+    }
+
+    static void Manage(ControlBlockBase<Counting>* base, BlockOp op) noexcept {
+        auto* self = static_cast<ControlBlockBackground*>(base);
+        if (op == BlockOp::kDestroyObject) {
+            self->IncrWeakCount();
+            self->reclaimer_.Push(self, &Destroy);
+        } else {
+            delete self;
+        }
+    }
+
+    static void Destroy(void* block) noexcept {
+        auto* self = static_cast<ControlBlockBackground*>(block);
+        self->Object()->~T();
+        self->DecrWeakCount();
+    }
+
+    BackgroundReclaimer& reclaimer_;
+};
+
+template <typename T, typename Counting, typename... Args>
+SharedPtr<T, Counting> BackgroundReclaimer::MakeShared(Args&&... args) {
+    static_assert(!kHasMainReference<Counting>, "use MakeReadMostly");
+    auto* block = new ControlBlockBackground<T, Counting>(*this);
+    return detail::AdoptShared<T, Counting>(block,
+                                            new (block->Object()) T(std::forward<Args>(args)...));
+}
+
+// Same as `MakeShared`, but the object is destroyed on the default reclaimer's thread
+template <typename T, typename Counting = AtomicCounting, typename... Args>
+SharedPtr<T, Counting> MakeSharedBackground(Args&&... args) {
+    return BackgroundReclaimer::Default().MakeShared<T, Counting>(std::forward<Args>(args)...);
+}
+
+// `UniquePtr` deleter that deletes on a reclaimer's thread
+template <typename T>
+class BackgroundDelete {
+public:
+    BackgroundDelete() noexcept : reclaimer_(&BackgroundReclaimer::Default()) {
+    }
+    explicit BackgroundDelete(BackgroundReclaimer& reclaimer) noexcept : reclaimer_(&reclaimer) {
+    }
+
+    void operator()(T* ptr) const noexcept {
+        reclaimer_->Push(ptr, [](void* object) noexcept { delete static_cast<T*>(object); });
+    }
+
+private:
+    BackgroundReclaimer* reclaimer_;
+};
@@ -0,0 +1,107 @@
+#include "atomic_shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Every thread loads the same published pointer; thread 0 also replaces it now and then
+static void BM_LoadAtomic(benchmark::State& state) {
+    static AtomicSharedPtr<int> slot(MakeShared<int>(0));
+    int i = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0 && ++i % 1024 == 0) {
+            slot.Store(MakeShared<int>(i));
+        }
+        SharedPtr<int> copy = slot.Load();
+        benchmark::DoNotOptimize(copy.Get());
+    }
+}
+BENCHMARK(BM_LoadAtomic)->ThreadRange(1, 64);
+
+static void BM_LoadMutex(benchmark::State& state) {
+    static std::mutex mutex;
+    static SharedPtr<int> shared = MakeShared<int>(0);
+    int i = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0 && ++i % 1024 == 0) {
+            auto fresh = MakeShared<int>(i);
+            std::lock_guard lock(mutex);
+            shared.Swap(fresh);
+        }
+        SharedPtr<int> copy;
+        {
+            std::lock_guard lock(mutex);
+            copy = shared;
+        }
+        benchmark::DoNotOptimize(copy.Get());
+    }
+}
+BENCHMARK(BM_LoadMutex)->ThreadRange(1, 64);
+
+// Round trip of a published pointer to a partner thread and back
+static void BM_HandoffWait(benchmark::State& state) {
+    AtomicSharedPtr<int> ping(MakeShared<int>(0));
+    AtomicSharedPtr<int> pong(MakeShared<int>(0));
+    SharedPtr<int> seen = ping.Load();
+    std::thread partner([&] {
+        while (true) {
+            ping.Wait(seen);
+            seen = ping.Load();
+            pong.Store(seen);
+            pong.NotifyOne();
+            if (!seen) {
+                return;
+            }
+        }
+    });
+    SharedPtr<int> reply = pong.Load();
+    int i = 0;
+    for (auto _ : state) {
+        ping.Store(MakeShared<int>(++i));
+        ping.NotifyOne();
+        pong.Wait(reply);
+        reply = pong.Load();
+    }
+    ping.Store(SharedPtr<int>());
+    ping.NotifyOne();
+    partner.join();
+}
+BENCHMARK(BM_HandoffWait)->UseRealTime();
+
+static void BM_HandoffConditionVariable(benchmark::State& state) {
+    std::mutex mutex;
+    std::condition_variable ping_changed;
+    std::condition_variable pong_changed;
+    SharedPtr<int> ping = MakeShared<int>(0);
+    SharedPtr<int> pong = ping;
+    SharedPtr<int> seen = ping;
+    std::thread partner([&] {
+        std::unique_lock lock(mutex);
+        while (true) {
+            ping_changed.wait(lock, [&] { return ping != seen; });
+            seen = ping;
+            pong = seen;
+            pong_changed.notify_one();
+            if (!seen) {
+                return;
+            }
+        }
+    });
+    int i = 0;
+    for (auto _ : state) {
+        auto fresh = MakeShared<int>(++i);
+        std::unique_lock lock(mutex);
+        ping = fresh;
+        ping_changed.notify_one();
+        pong_changed.wait(lock, [&] { return pong == fresh; });
+    }
+    {
+        std::lock_guard lock(mutex);
+        ping.Reset();
+    }
+    ping_changed.notify_one();
+    partner.join();
+}
+BENCHMARK(BM_HandoffConditionVariable)->UseRealTime();
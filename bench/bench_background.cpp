@@ -0,0 +1,52 @@
+#include "background.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Costs about one free per node to destroy
+struct Index {
+    explicit Index(size_t nodes) {
+        for (size_t i = 0; i < nodes; ++i) {
+            entries.push_back(std::make_unique<size_t>(i));
+        }
+    }
+    std::vector<std::unique_ptr<size_t>> entries;
+};
+
+// A fixed number of releases each: a background one is timed so short that the default run would
+// build indexes for minutes
+template <typename Make>
+void MeasureRelease(benchmark::State& state, Make make) {
+    std::vector<double> samples;
+    for (auto _ : state) {
+        auto ptr = make(static_cast<size_t>(state.range(0)));
+        const auto start = std::chrono::steady_clock::now();
+        ptr.Reset();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        state.SetIterationTime(elapsed.count());
+        samples.push_back(elapsed.count());
+        // Untimed, and keeps the queue from piling up indexes
+        BackgroundReclaimer::Default().Drain();
+    }
+    std::sort(samples.begin(), samples.end());
+    state.counters["p99_us"] = samples[samples.size() * 99 / 100] * 1e6;
+}
+
+}  // namespace
+
+// Time the releasing thread spends dropping the last reference
+static void BM_ReleaseInline(benchmark::State& state) {
+    MeasureRelease(state, [](size_t nodes) { return MakeShared<Index>(nodes); });
+}
+BENCHMARK(BM_ReleaseInline)->Arg(1 << 10)->Arg(1 << 16)->Iterations(500)->UseManualTime();
+
+static void BM_ReleaseBackground(benchmark::State& state) {
+    MeasureRelease(state, [](size_t nodes) { return MakeSharedBackground<Index>(nodes); });
+}
+BENCHMARK(BM_ReleaseBackground)->Arg(1 << 10)->Arg(1 << 16)->Iterations(500)->UseManualTime();
@@ -0,0 +1,47 @@
+#include "shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+template <int N>
+struct Message {
+    char payload[48];
+};
+
+}  // namespace
+
+// One thread allocates and drops the same type
+static void BM_Churn(benchmark::State& state) {
+    using M = Message<1>;
+    SetRecycleCapacity<M>(state.range(0));
+    for (auto _ : state) {
+        auto ptr = MakeShared<M>();
+        benchmark::DoNotOptimize(ptr.Get());
+    }
+}
+BENCHMARK(BM_Churn)->Arg(0)->Arg(64);
+
+// A producer allocates batches that a consumer thread drops
+static void BM_ProducerConsumer(benchmark::State& state) {
+    using M = Message<2>;
+    constexpr size_t kBatch = 256;
+    SetRecycleCapacity<M>(state.range(0));
+    const RecycleStats before = GetRecycleStats<M>();
+    for (auto _ : state) {
+        std::vector<SharedPtr<M>> batch;
+        batch.reserve(kBatch);
+        for (size_t i = 0; i < kBatch; ++i) {
+            batch.push_back(MakeShared<M>());
+        }
+        std::thread([&batch] { batch.clear(); }).join();
+    }
+    const RecycleStats after = GetRecycleStats<M>();
+    const double allocations = static_cast<double>(state.iterations() * kBatch);
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    state.counters["hit_rate"] = static_cast<double>(after.hits - before.hits) / allocations;
+}
+BENCHMARK(BM_ProducerConsumer)->Arg(0)->Arg(64);
@@ -0,0 +1,37 @@
+#include "shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+
+namespace {
+
+struct Adjacent {
+    std::atomic<int> value = 0;
+};
+
+struct Isolated {
+    std::atomic<int> value = 0;
+};
+
+}  // namespace
+
+template <>
+struct IsolateControlBlock<Isolated> : std::true_type {};
+
+// Thread 0 keeps writing the object while the others copy pointers to it. Without isolation the
+// writes and the count updates fight over one cache line.
+template <typename T>
+static void BM_WriteWhileCopying(benchmark::State& state) {
+    static SharedPtr<T> shared = MakeShared<T>();
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            shared->value.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            SharedPtr<T> copy = shared;
+            benchmark::DoNotOptimize(copy);
+        }
+    }
+}
+BENCHMARK_TEMPLATE(BM_WriteWhileCopying, Adjacent)->ThreadRange(2, 64);
+BENCHMARK_TEMPLATE(BM_WriteWhileCopying, Isolated)->ThreadRange(2, 64);
@@ -0,0 +1,45 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+// Copy and drop of a pointer whose block the thread shares with nobody else
+template <typename Pointer>
+static void BM_CopyDrop(benchmark::State& state, Pointer ptr) {
+    for (auto _ : state) {
+        Pointer copy = ptr;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+BENCHMARK_CAPTURE(BM_CopyDrop, std_shared_ptr, std::make_shared<int>(0));
+BENCHMARK_CAPTURE(BM_CopyDrop, atomic, MakeShared<int>(0));
+BENCHMARK_CAPTURE(BM_CopyDrop, local, MakeShared<int, LocalCounting>(0));
+// Copies stay on the thread that made the block, so they never touch an atomic
+BENCHMARK_CAPTURE(BM_CopyDrop, biased, MakeShared<int, BiasedCounting>(0));
+
+// All threads copy the same pointer
+static void BM_ContendedCopyDrop(benchmark::State& state) {
+    static SharedPtr<int> shared = MakeShared<int>(0);
+    for (auto _ : state) {
+        SharedPtr<int> copy = shared;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK(BM_ContendedCopyDrop)->ThreadRange(1, 32);
+
+// All threads promote weak references to one live object. Atomic counts promote with a CAS loop
+// that retries under contention, sticky ones with a single fetch_add
+template <typename Counting>
+static void BM_ContendedPromotion(benchmark::State& state) {
+    static SharedPtr<int, Counting> shared = MakeShared<int, Counting>(0);
+    WeakPtr<int, Counting> weak = shared;
+    for (auto _ : state) {
+        SharedPtr<int, Counting> locked = weak.TryLock();
+        benchmark::DoNotOptimize(locked);
+    }
+}
+BENCHMARK_TEMPLATE(BM_ContendedPromotion, AtomicCounting)->ThreadRange(1, 64);
+BENCHMARK_TEMPLATE(BM_ContendedPromotion, StickyCounting)->ThreadRange(1, 64);
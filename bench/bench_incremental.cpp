@@ -0,0 +1,74 @@
+#include "incremental.h"
+#include "shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+struct Node {
+    std::vector<SharedPtr<Node>> children;
+};
+
+// 8^6 leaves, about 300k nodes
+SharedPtr<Node> MakeTree(int depth) {
+    auto node = MakeShared<Node>();
+    if (depth > 0) {
+        for (int i = 0; i < 8; ++i) {
+            node->children.push_back(MakeTree(depth - 1));
+        }
+    }
+    return node;
+}
+
+constexpr int kDepth = 6;
+
+double Seconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+}  // namespace
+
+// Longest pause an event loop sees while the graph goes away: the whole teardown at once
+static void BM_PauseRecursive(benchmark::State& state) {
+    for (auto _ : state) {
+        SharedPtr<Node> root = MakeTree(kDepth);
+        const auto start = std::chrono::steady_clock::now();
+        root.Reset();
+        state.SetIterationTime(Seconds(std::chrono::steady_clock::now() - start));
+    }
+}
+BENCHMARK(BM_PauseRecursive)->Iterations(10)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+// ... or its longest step of `range(0)` microseconds
+static void BM_PauseIncremental(benchmark::State& state) {
+    const std::chrono::microseconds budget(state.range(0));
+    IncrementalReclaimer reclaimer;
+    size_t steps = 0;
+    for (auto _ : state) {
+        SharedPtr<Node> root = MakeTree(kDepth);
+        std::chrono::steady_clock::duration longest{};
+        auto start = std::chrono::steady_clock::now();
+        root.Reset();
+        bool pending = true;
+        while (pending) {
+            pending = reclaimer.Step(budget);
+            const auto end = std::chrono::steady_clock::now();
+            longest = std::max(longest, end - start);
+            start = end;
+            ++steps;
+        }
+        state.SetIterationTime(Seconds(longest));
+    }
+    state.counters["steps"] = benchmark::Counter(static_cast<double>(steps),
+                                                 benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_PauseIncremental)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Iterations(10)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
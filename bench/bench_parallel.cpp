@@ -0,0 +1,57 @@
+#include "parallel.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace {
+
+struct Node {
+    std::vector<SharedPtr<Node>> children;
+    // Some destruction work besides the frees
+    std::vector<int> payload = std::vector<int>(16);
+};
+
+SharedPtr<Node> BuildTree(int depth, int fanout) {
+    auto node = MakeShared<Node>();
+    if (depth > 0) {
+        for (int i = 0; i < fanout; ++i) {
+            node->children.push_back(BuildTree(depth - 1, fanout));
+        }
+    }
+    return node;
+}
+
+constexpr int kDepth = 6;
+constexpr int kFanout = 8;  // 299593 nodes
+
+}  // namespace
+
+// Nodes torn down per second by a pool of `range(0)` threads
+static void BM_ParallelTeardown(benchmark::State& state) {
+    ParallelReclaimer pool(state.range(0));
+    int64_t nodes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto root = BuildTree(kDepth, kFanout);
+        state.ResumeTiming();
+        pool.Teardown(std::move(root));
+        nodes += 299593;
+    }
+    state.SetItemsProcessed(nodes);
+}
+BENCHMARK(BM_ParallelTeardown)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
+
+// Baseline: the dropping thread destroys everything itself
+static void BM_InlineTeardown(benchmark::State& state) {
+    int64_t nodes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto root = BuildTree(kDepth, kFanout);
+        state.ResumeTiming();
+        root.Reset();
+        nodes += 299593;
+    }
+    state.SetItemsProcessed(nodes);
+}
+BENCHMARK(BM_InlineTeardown)->UseRealTime();
@@ -0,0 +1,23 @@
+#include "read_mostly.h"
+
+#include <benchmark/benchmark.h>
+
+// Every thread copies the same global object; sharded copies should cost the same at any count
+static void BM_CopyReadMostly(benchmark::State& state) {
+    static ReadMostlyMainPtr<int> main = MakeReadMostly<int>(0);
+    ReadMostlySharedPtr<int> shared = main.GetShared();
+    for (auto _ : state) {
+        ReadMostlySharedPtr<int> copy = shared;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK(BM_CopyReadMostly)->ThreadRange(1, 64);
+
+static void BM_CopyAtomic(benchmark::State& state) {
+    static SharedPtr<int> shared = MakeShared<int>(0);
+    for (auto _ : state) {
+        SharedPtr<int> copy = shared;
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK(BM_CopyAtomic)->ThreadRange(1, 64);
@@ -0,0 +1,39 @@
+#include "shared.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+using detail::SlabAllocator;
+
+static void BM_SlabAllocateFree(benchmark::State& state) {
+    for (auto _ : state) {
+        void* block = SlabAllocator::Allocate(32, 16);
+        benchmark::DoNotOptimize(block);
+        SlabAllocator::Deallocate(block, 32, 16);
+    }
+}
+BENCHMARK(BM_SlabAllocateFree)->ThreadRange(1, 8);
+
+static void BM_GlobalNewDelete(benchmark::State& state) {
+    for (auto _ : state) {
+        void* block = ::operator new(32);
+        benchmark::DoNotOptimize(block);
+        ::operator delete(block);
+    }
+}
+BENCHMARK(BM_GlobalNewDelete)->ThreadRange(1, 8);
+
+// Batches of live blocks, as when a thread builds and drops a container of `MakeShared` objects
+static void BM_MakeSharedBatch(benchmark::State& state) {
+    std::vector<SharedPtr<int>> batch;
+    batch.reserve(state.range(0));
+    for (auto _ : state) {
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            batch.push_back(MakeShared<int>(0));
+        }
+        batch.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MakeSharedBatch)->Arg(1024)->ThreadRange(1, 8);
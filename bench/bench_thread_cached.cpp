@@ -0,0 +1,21 @@
+#include "thread_cached.h"
+
+#include <benchmark/benchmark.h>
+
+// Every thread reads the same rarely changing pointer
+static void BM_ReadCached(benchmark::State& state) {
+    static ThreadCachedSharedPtr<int> cached(MakeShared<int>(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cached.Get().Get());
+    }
+}
+BENCHMARK(BM_ReadCached)->ThreadRange(1, 64);
+
+static void BM_ReadCopy(benchmark::State& state) {
+    static SharedPtr<int> shared = MakeShared<int>(0);
+    for (auto _ : state) {
+        SharedPtr<int> copy = shared;
+        benchmark::DoNotOptimize(copy.Get());
+    }
+}
+BENCHMARK(BM_ReadCopy)->ThreadRange(1, 64);
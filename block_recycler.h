@@ -0,0 +1,169 @@
+#pragma once
+
+#include "slab.h"
+#include "thread_state.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>  // size_t
+#include <mutex>
+#include <vector>
+
+// Hits and misses of a block recycler, summed over all threads
+struct RecycleStats {
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+namespace detail {
+
+// Per-thread stack of freed storage for one block type, off until given a capacity. A freed
+// block is pushed there instead of going back to the slabs, and the next allocation on the
+// thread pops it, so steady-state churn of one type costs a pointer pop and push.
+//
+// A thread whose stack is full moves half of it to a bounded list shared by all threads, and a
+// thread whose stack is empty takes up to half a stack from there, so blocks freed by a consumer
+// thread get back to the producer that allocates them in batches under one lock.
+template <typename Block>
+class BlockRecycler {
+public:
+    static void SetCapacity(size_t per_thread, size_t shared) noexcept {
+        capacity_.store(per_thread, std::memory_order_relaxed);
+        shared_capacity_.store(shared, std::memory_order_relaxed);
+    }
+
+    static RecycleStats Stats() noexcept {
+        Shared& shared = Global();
+        std::lock_guard lock(shared.mutex);
+        RecycleStats stats{shared.exited_hits, shared.exited_misses};
+        for (const Cache* cache : shared.caches) {
+            stats.hits += cache->hits.load(std::memory_order_relaxed);
+            stats.misses += cache->misses.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    // Blocks of other sizes (derived ones) are not recycled
+    static void* Allocate(size_t size, size_t align) {
+        if (size == sizeof(Block) && capacity_.load(std::memory_order_relaxed) != 0) {
+            if (Cache* cache = LocalCache()) {
+                if (cache->free.empty() && shared_size_.load(std::memory_order_relaxed) != 0) {
+                    Refill(*cache);
+                }
+                if (!cache->free.empty()) {
+                    Count(cache->hits);
+                    void* storage = cache->free.back();
+                    cache->free.pop_back();
+                    return storage;
+                }
+                Count(cache->misses);
+            }
+        }
+        return SlabAllocator::Allocate(size, align);
+    }
+
+    static void Deallocate(void* storage, size_t size, size_t align) noexcept {
+        if (size == sizeof(Block) && align == alignof(Block)) {
+            const size_t capacity = capacity_.load(std::memory_order_relaxed);
+            Cache* cache = capacity != 0 ? LocalCache() : nullptr;
+            if (cache) {
+                if (cache->free.size() >= capacity) {
+                    SpillHalf(cache->free, Give);
+                }
+                if (cache->free.size() < capacity) {
+                    try {
+                        if (cache->free.capacity() < capacity) {
+                            cache->free.reserve(capacity);
+                        }
+                        cache->free.push_back(storage);
+                        return;
+                    } catch (...) {
+                    }
+                }
+            }
+        }
+        SlabAllocator::Deallocate(storage, size, align);
+    }
+
+private:
+    // Counters are written by their thread only and read by `Stats()`
+    struct Cache {
+        // A cache that cannot be listed only leaves its counts out of `Stats()` until it exits
+        Cache() {
+            Shared& shared = Global();
+            std::lock_guard lock(shared.mutex);
+            try {
+                shared.caches.push_back(this);
+            } catch (...) {
+            }
+        }
+        ~Cache() {
+            Give(free.data(), free.data() + free.size());
+            Shared& shared = Global();
+            std::lock_guard lock(shared.mutex);
+            std::erase(shared.caches, this);
+            shared.exited_hits += hits.load(std::memory_order_relaxed);
+            shared.exited_misses += misses.load(std::memory_order_relaxed);
+        }
+
+        std::vector<void*> free;
+        std::atomic<size_t> hits = 0;
+        std::atomic<size_t> misses = 0;
+    };
+
+    struct Shared {
+        std::mutex mutex;
+        std::vector<void*> free;
+        std::vector<Cache*> caches;
+        size_t exited_hits = 0;
+        size_t exited_misses = 0;
+    };
+
+    // Lives as long as the program: blocks may be freed during static destruction
+    static Shared& Global() {
+        static auto* shared = new Shared;
+        return *shared;
+    }
+
+    // Null once the calling thread is past destroying its thread-locals
+    static Cache* LocalCache() noexcept {
+        return ThreadLocal<Cache>();
+    }
+
+    static void Count(std::atomic<size_t>& counter) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static void Refill(Cache& cache) {
+        Shared& shared = Global();
+        std::lock_guard lock(shared.mutex);
+        RefillHalf(cache.free, shared.free, capacity_.load(std::memory_order_relaxed));
+        shared_size_.store(shared.free.size(), std::memory_order_relaxed);
+    }
+
+    // What the shared list has no room for goes back to the slabs
+    static void Give(void* const* first, void* const* last) noexcept {
+        Shared& shared = Global();
+        {
+            std::lock_guard lock(shared.mutex);
+            const size_t limit = shared_capacity_.load(std::memory_order_relaxed);
+            const size_t room = limit > shared.free.size() ? limit - shared.free.size() : 0;
+            const size_t count = std::min<size_t>(room, last - first);
+            try {
+                shared.free.insert(shared.free.end(), first, first + count);
+                first += count;
+            } catch (...) {
+            }
+            shared_size_.store(shared.free.size(), std::memory_order_relaxed);
+        }
+        for (; first != last; ++first) {
+            SlabAllocator::Deallocate(*first, sizeof(Block), alignof(Block));
+        }
+    }
+
+    static inline std::atomic<size_t> capacity_ = 0;
+    static inline std::atomic<size_t> shared_capacity_ = 0;
+    static inline std::atomic<size_t> shared_size_ = 0;
+};
+
+}  // namespace detail
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "bounded_queue.h"
+#include "block_recycler.h"
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdlib>  // std::abort
+#include <mutex>
+#include <new>
+
+namespace detail {
+
+// Set on threads that must not reach the allocator (see realtime.h)
+class RealtimeContext {
+public:
+    static bool Active() noexcept {
+        return depth_ > 0;
+    }
+    static void Enter() noexcept {
+        ++depth_;
+    }
+    static void Leave() noexcept {
+        --depth_;
+    }
+
+    // Called by the trapping allocation functions (see realtime.h)
+    static void OnAllocation() noexcept {
+        if (Active()) {
+            trap_.load(std::memory_order_relaxed)();
+        }
+    }
+    static void SetTrap(void (*trap)()) noexcept {
+        trap_.store(trap, std::memory_order_relaxed);
+    }
+
+private:
+    static inline thread_local size_t depth_ = 0;
+    static inline std::atomic<void (*)()> trap_ = &std::abort;
+};
+
+// Preallocated storage for one block type, filled by `Reserve()` ahead of time. A real-time
+// thread takes storage from it instead of the allocator, and freed blocks refill it up to its
+// capacity, so blocks from either source are interchangeable. The first `Reserve()` fixes the
+// capacity.
+template <typename Block>
+class BlockReserve {
+public:
+    static void Reserve(size_t count) {
+        BoundedQueue<void*>* queue = Queue(count);
+        for (size_t i = 0; i < count; ++i) {
+            void* storage = New(sizeof(Block), alignof(Block));
+            if (!queue->TryPush(storage)) {
+                Delete(storage, sizeof(Block), alignof(Block));
+                break;
+            }
+        }
+    }
+
+    // Blocks of other sizes (derived ones) always go to the allocator
+    static void* Allocate(size_t size, size_t align) {
+        if (size == sizeof(Block) && RealtimeContext::Active()) {
+            if (BoundedQueue<void*>* queue = queue_.load(std::memory_order_acquire)) {
+                void* storage;
+                if (queue->TryPop(storage)) {
+                    return storage;
+                }
+            }
+        }
+        return New(size, align);
+    }
+
+    static void Deallocate(void* storage, size_t size, size_t align) noexcept {
+        if (size == sizeof(Block) && align == alignof(Block)) {
+            if (BoundedQueue<void*>* queue = queue_.load(std::memory_order_acquire)) {
+                if (queue->TryPush(storage)) {
+                    return;
+                }
+            }
+        }
+        Delete(storage, size, align);
+    }
+
+private:
+    // Lives as long as the program; blocks may be freed during static destruction
+    static BoundedQueue<void*>* Queue(size_t capacity) {
+        static std::mutex mutex;
+        std::lock_guard lock(mutex);
+        BoundedQueue<void*>* queue = queue_.load(std::memory_order_relaxed);
+        if (!queue) {
+            queue = new BoundedQueue<void*>(capacity);
+            queue_.store(queue, std::memory_order_release);
+        }
+        return queue;
+    }
+
+    static void* New(size_t size, size_t align) {
+        return BlockRecycler<Block>::Allocate(size, align);
+    }
+    static void Delete(void* storage, size_t size, size_t align) noexcept {
+        BlockRecycler<Block>::Deallocate(storage, size, align);
+    }
+
+    static inline std::atomic<BoundedQueue<void*>*> queue_ = nullptr;
+};
+
+}  // namespace detail
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "counting.h"  // kCacheLineSize
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>  // size_t
+#include <cstdint>  // std::intptr_t
+#include <memory>
+
+namespace detail {
+
+// Bounded lock-free MPMC ring (Vyukov): every cell carries a sequence number telling producers
+// and consumers whose turn it is, so neither side ever allocates, frees or dereferences a node
+// another thread may hold. The capacity is rounded up to a power of two, and to at least 2: with
+// one cell, a push and a pop would leave it the same sequence number.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1), cells_(new Cell[mask_ + 1]) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Fails when full
+    bool TryPush(const T& value) noexcept {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(sequence - pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Fails when empty, or when the oldest push has claimed its cell but not filled it yet
+    bool TryPop(T& value) noexcept {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(sequence - (pos + 1));
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Pushes that have claimed a cell, finished or not
+    size_t Claimed() const noexcept {
+        return tail_.load(std::memory_order_seq_cst);
+    }
+
+    size_t Capacity() const noexcept {
+        return mask_ + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(kCacheLineSize) std::atomic<size_t> tail_ = 0;
+    alignas(kCacheLineSize) std::atomic<size_t> head_ = 0;
+};
+
+}  // namespace detail
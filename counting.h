@@ -0,0 +1,849 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>  // uint16_t, uint64_t, std::intptr_t, std::uintptr_t
+#include <new>      // std::hardware_destructive_interference_size
+
+#ifdef __cpp_lib_hardware_interference_size
+// GCC warns that the value depends on -mtune; block layout is not part of any ABI here
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+inline constexpr size_t kCacheLineSize = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
+inline constexpr size_t kCacheLineSize = 64;
+#endif
+
+// A counting policy owns the shared and weak counts of a control block.
+//
+// A policy may also keep the block's 16-bit type tag in spare bits, through `SetTag()` (called
+// once, before the block is shared) and `Tag()`; its blocks then carry no manager pointer.
+//
+// Shared owners collectively hold one weak reference, so a block starts at shared = 1, weak = 1
+// and the block itself is released only after the object is gone and the last weak reference
+// is dropped. `DecrShared()`/`DecrWeak()` return true when the respective count reaches zero.
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Plain counts: cheapest, but only valid while every copy stays on one thread
+
+namespace detail {
+
+// Type tags take the top bits of a 64-bit weak count; no block gets anywhere near 2^48 weak
+// references
+inline constexpr unsigned kTagShift = 48;
+inline constexpr size_t kWeakMask = (size_t{1} << kTagShift) - 1;
+static_assert(sizeof(size_t) == 8);
+
+}  // namespace detail
+
+class LocalCounting {
+public:
+    void IncrShared() noexcept {
+        ++shared_cnt_;
+    }
+    bool DecrShared() noexcept {
+        return --shared_cnt_ == 0;
+    }
+    size_t SharedCount() const noexcept {
+        return shared_cnt_;
+    }
+    bool IncrSharedIfNotZero() noexcept {
+        if (shared_cnt_ == 0) {
+            return false;
+        }
+        ++shared_cnt_;
+        return true;
+    }
+
+    void IncrWeak() noexcept {
+        ++weak_cnt_;
+    }
+    bool DecrWeak() noexcept {
+        return (--weak_cnt_ & detail::kWeakMask) == 0;
+    }
+
+    void SetTag(uint16_t tag) noexcept {
+        weak_cnt_ = (weak_cnt_ & detail::kWeakMask) | size_t{tag} << detail::kTagShift;
+    }
+    uint16_t Tag() const noexcept {
+        return static_cast<uint16_t>(weak_cnt_ >> detail::kTagShift);
+    }
+
+private:
+    size_t shared_cnt_ = 1;
+    size_t weak_cnt_ = 1;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Thread-safe counts
+
+class AtomicCounting {
+public:
+    // A new reference is always made from an existing one, so nothing needs to be ordered here
+    void IncrShared() noexcept {
+        shared_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Release publishes our writes to the object; the acquire fence on the last decrement makes
+    // every other owner's writes visible before the destructor runs
+    bool DecrShared() noexcept {
+        if (shared_cnt_.fetch_sub(1, std::memory_order_release) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+    size_t SharedCount() const noexcept {
+        return shared_cnt_.load(std::memory_order_relaxed);
+    }
+    // Promotes a weak reference: once the count has hit zero the object is gone for good
+    bool IncrSharedIfNotZero() noexcept {
+        size_t count = shared_cnt_.load(std::memory_order_relaxed);
+        do {
+            if (count == 0) {
+                return false;
+            }
+        } while (!shared_cnt_.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                                    std::memory_order_relaxed));
+        return true;
+    }
+
+    void IncrWeak() noexcept {
+        weak_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bool DecrWeak() noexcept {
+        if ((weak_cnt_.fetch_sub(1, std::memory_order_release) & detail::kWeakMask) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+    // The tag bits never change once set, so neither side needs ordering
+    void SetTag(uint16_t tag) noexcept {
+        const size_t weak = weak_cnt_.load(std::memory_order_relaxed) & detail::kWeakMask;
+        weak_cnt_.store(weak | size_t{tag} << detail::kTagShift, std::memory_order_relaxed);
+    }
+    uint16_t Tag() const noexcept {
+        return static_cast<uint16_t>(weak_cnt_.load(std::memory_order_relaxed) >>
+                                     detail::kTagShift);
+    }
+
+private:
+    std::atomic<size_t> shared_cnt_ = 1;
+    std::atomic<size_t> weak_cnt_ = 1;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Both counts packed into one word: `SharedBits` low bits for shared references, the rest for
+// weak ones. A block that never had a weak reference is released by a single atomic load in
+// `ReleaseIfLast()` instead of a decrement per count.
+
+template <unsigned SharedBits = 32>
+class PackedCounting {
+    static_assert(SharedBits > 0 && SharedBits < 64);
+
+public:
+    void IncrShared() noexcept {
+        word_.fetch_add(kSharedOne, std::memory_order_relaxed);
+    }
+    bool DecrShared() noexcept {
+        if (Shared(word_.fetch_sub(kSharedOne, std::memory_order_release)) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+    size_t SharedCount() const noexcept {
+        return Shared(word_.load(std::memory_order_relaxed));
+    }
+    bool IncrSharedIfNotZero() noexcept {
+        uint64_t word = word_.load(std::memory_order_relaxed);
+        do {
+            if (Shared(word) == 0) {
+                return false;
+            }
+        } while (!word_.compare_exchange_weak(word, word + kSharedOne, std::memory_order_acquire,
+                                              std::memory_order_relaxed));
+        return true;
+    }
+
+    void IncrWeak() noexcept {
+        word_.fetch_add(kWeakOne, std::memory_order_relaxed);
+    }
+    bool DecrWeak() noexcept {
+        if (Weak(word_.fetch_sub(kWeakOne, std::memory_order_release)) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+    // The sole shared owner with no weak references around: nobody else can reach the block, so
+    // both counts are dropped without writing them
+    bool ReleaseIfLast() noexcept {
+        return word_.load(std::memory_order_acquire) == kSharedOne + kWeakOne;
+    }
+
+private:
+    static constexpr uint64_t kSharedOne = 1;
+    static constexpr uint64_t kWeakOne = uint64_t{1} << SharedBits;
+
+    static size_t Shared(uint64_t word) noexcept {
+        return static_cast<size_t>(word & (kWeakOne - 1));
+    }
+    static size_t Weak(uint64_t word) noexcept {
+        return static_cast<size_t>(word >> SharedBits);
+    }
+
+    std::atomic<uint64_t> word_ = kSharedOne + kWeakOne;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Wait-free shared count with a sticky zero: once the count reaches zero a flag bit is set and
+// never cleared, so promoting a weak reference is a single fetch_add instead of a CAS loop that
+// retries under contention. Increments that land after the zero only bump the dead counter.
+//
+// A decrement that brings the count to zero races with readers that may observe the zero first;
+// a reader that sees a plain zero marks it as helped, and the decrement that made it zero claims
+// the release by taking the helped flag.
+
+class StickyCounting {
+public:
+    void IncrShared() noexcept {
+        shared_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bool DecrShared() noexcept {
+        if (shared_cnt_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            uint64_t expected = 0;
+            if (shared_cnt_.compare_exchange_strong(expected, kZero, std::memory_order_acq_rel)) {
+                return true;
+            }
+            return (expected & kHelped) &&
+                   (shared_cnt_.exchange(kZero, std::memory_order_acq_rel) & kHelped);
+        }
+        return false;
+    }
+    size_t SharedCount() const noexcept {
+        uint64_t value = shared_cnt_.load(std::memory_order_acquire);
+        if (value == 0 && shared_cnt_.compare_exchange_strong(value, kZero | kHelped,
+                                                              std::memory_order_acq_rel)) {
+            return 0;
+        }
+        return (value & kZero) ? 0 : static_cast<size_t>(value);
+    }
+    bool IncrSharedIfNotZero() noexcept {
+        return (shared_cnt_.fetch_add(1, std::memory_order_acquire) & kZero) == 0;
+    }
+
+    void IncrWeak() noexcept {
+        weak_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bool DecrWeak() noexcept {
+        if (weak_cnt_.fetch_sub(1, std::memory_order_release) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    static constexpr uint64_t kZero = uint64_t{1} << 63;
+    static constexpr uint64_t kHelped = uint64_t{1} << 62;
+
+    // Readers help a transient zero stick
+    mutable std::atomic<uint64_t> shared_cnt_ = 1;
+    std::atomic<size_t> weak_cnt_ = 1;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Biased counts: the thread that created the block counts with plain loads and stores, every
+// other thread uses an atomic counter. The two are merged when the owner's count drops to zero.
+//
+// A non-owner that drops a reference the owner counted drives the atomic counter below zero.
+// Only the owner can fold its count in, so the block is queued to the owner thread, which
+// merges it on its next biased release or when it exits.
+
+class BiasedCounting;
+
+namespace detail {
+
+class BiasedOwner {
+public:
+    // Past the thread's thread-locals, blocks get an owner that is closed from the start
+    static BiasedOwner* Current() noexcept {
+        if (exited_) {
+            return Orphan();
+        }
+        thread_local Holder holder;
+        return holder.owner;
+    }
+    // The calling thread's owner while it may still count biased; nullptr once it exits
+    static BiasedOwner* Active() noexcept {
+        return active_;
+    }
+
+    void Retain() noexcept {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    void Release() noexcept {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    bool HasQueued() const noexcept {
+        BiasedCounting* head = queue_.load(std::memory_order_relaxed);
+        return head != nullptr && head != Closed();
+    }
+
+    // Returns false once the owner thread has exited
+    bool Push(BiasedCounting* counts) noexcept;
+    void Drain() noexcept;
+
+private:
+    // The thread stops counting biased before the queue closes, so releases it makes while the
+    // queue is merged or from later thread-local destructors take the atomic path and merge at once
+    struct Holder {
+        Holder() : owner(new BiasedOwner) {
+            active_ = owner;
+        }
+        ~Holder() {
+            active_ = nullptr;
+            exited_ = true;
+            owner->Close();
+            owner->Release();
+        }
+        BiasedOwner* owner;
+    };
+
+    static BiasedCounting* Closed() noexcept {
+        return reinterpret_cast<BiasedCounting*>(std::uintptr_t{1});
+    }
+
+    // Never freed; blocks retain it like any other owner
+    static BiasedOwner* Orphan() noexcept {
+        static BiasedOwner* orphan = [] {
+            auto* owner = new BiasedOwner;
+            owner->queue_.store(Closed(), std::memory_order_relaxed);
+            return owner;
+        }();
+        return orphan;
+    }
+
+    void MergeAll(BiasedCounting* head) noexcept;
+    void Close() noexcept;
+
+    static inline thread_local BiasedOwner* active_ = nullptr;
+    static inline thread_local bool exited_ = false;
+
+    std::atomic<BiasedCounting*> queue_ = nullptr;
+    std::atomic<size_t> refs_ = 1;
+};
+
+}  // namespace detail
+
+class BiasedCounting {
+public:
+    // Finishes a release that was deferred to the owner thread; `last_shared` tells whether the
+    // merge found no shared references left. Installed by the control block via `Bind()`.
+    using ReleaseFn = void (*)(void* block, bool last_shared) noexcept;
+
+    BiasedCounting() noexcept : owner_(detail::BiasedOwner::Current()) {
+        owner_->Retain();
+        if (owner_->HasQueued()) {
+            owner_->Drain();
+        }
+    }
+    ~BiasedCounting() {
+        owner_->Release();
+    }
+
+    BiasedCounting(const BiasedCounting&) = delete;
+    BiasedCounting& operator=(const BiasedCounting&) = delete;
+
+    void Bind(void* block, ReleaseFn release) noexcept {
+        block_ = block;
+        release_ = release;
+    }
+
+    void IncrShared() noexcept {
+        if (IsBiased()) {
+            biased_cnt_.store(biased_cnt_.load(std::memory_order_relaxed) + 1,
+                              std::memory_order_relaxed);
+        } else {
+            shared_cnt_.fetch_add(kOne, std::memory_order_relaxed);
+        }
+    }
+    bool DecrShared() noexcept {
+        if (IsOwner()) {
+            if (owner_->HasQueued()) {
+                owner_->Drain();
+            }
+            if (!merged_) {
+                const size_t biased = biased_cnt_.load(std::memory_order_relaxed) - 1;
+                biased_cnt_.store(biased, std::memory_order_relaxed);
+                return biased == 0 && Merge();
+            }
+        }
+        return DecrUnbiased();
+    }
+    // Exact on the owner thread, a snapshot elsewhere
+    size_t SharedCount() const noexcept {
+        const std::intptr_t shared = Count(shared_cnt_.load(std::memory_order_relaxed));
+        return static_cast<size_t>(
+            shared + static_cast<std::intptr_t>(biased_cnt_.load(std::memory_order_relaxed)));
+    }
+    // Until the merge the owner still holds a biased reference, so the object is alive
+    bool IncrSharedIfNotZero() noexcept {
+        if (IsBiased()) {
+            IncrShared();
+            return true;
+        }
+        std::intptr_t value = shared_cnt_.load(std::memory_order_relaxed);
+        do {
+            if ((value & kMerged) && Count(value) == 0) {
+                return false;
+            }
+        } while (!shared_cnt_.compare_exchange_weak(value, value + kOne, std::memory_order_acquire,
+                                                    std::memory_order_relaxed));
+        return true;
+    }
+
+    void IncrWeak() noexcept {
+        weak_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bool DecrWeak() noexcept {
+        if (weak_cnt_.fetch_sub(1, std::memory_order_release) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    friend class detail::BiasedOwner;
+
+    // `shared_cnt_` keeps the count above two flag bits; the count may go negative until merged
+    static constexpr std::intptr_t kMerged = 1;
+    static constexpr std::intptr_t kQueued = 2;
+    static constexpr std::intptr_t kOne = 4;
+
+    static std::intptr_t Count(std::intptr_t value) noexcept {
+        return value >> 2;
+    }
+
+    bool IsOwner() const noexcept {
+        return owner_ == detail::BiasedOwner::Active();
+    }
+    bool IsBiased() const noexcept {
+        return IsOwner() && !merged_;
+    }
+
+    // Folds the biased count into the atomic one; afterwards every thread uses the atomic path.
+    // Runs on the owner thread, or on the thread that found the owner gone.
+    bool Merge() noexcept {
+        merged_ = true;
+        const auto biased = static_cast<std::intptr_t>(biased_cnt_.exchange(0));
+        const std::intptr_t old =
+            shared_cnt_.fetch_add(biased * kOne + kMerged, std::memory_order_acq_rel);
+        return Count(old) + biased == 0;
+    }
+
+    bool DecrUnbiased() noexcept {
+        const std::intptr_t old = shared_cnt_.fetch_sub(kOne, std::memory_order_release);
+        if (old & kMerged) {
+            if (Count(old) == 1) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return true;
+            }
+            return false;
+        }
+        if (Count(old) > 0 || (old & kQueued)) {
+            return false;
+        }
+        return RequestMerge();
+    }
+
+    bool RequestMerge() noexcept {
+        const std::intptr_t prev = shared_cnt_.fetch_or(kQueued, std::memory_order_acq_rel);
+        if (prev & (kQueued | kMerged)) {
+            return false;
+        }
+        // The queue keeps the block alive until the owner gets to it
+        IncrWeak();
+        if (owner_->Push(this)) {
+            return false;
+        }
+        // The owner thread is gone, so nobody else touches the biased count any more
+        DecrWeak();
+        return Merge();
+    }
+
+    void MergeQueued() noexcept {
+        const bool last_shared = !merged_ && Merge();
+        release_(block_, last_shared);
+    }
+
+    detail::BiasedOwner* owner_;
+    bool merged_ = false;
+    std::atomic<size_t> biased_cnt_ = 1;
+    std::atomic<std::intptr_t> shared_cnt_ = 0;
+    std::atomic<size_t> weak_cnt_ = 1;
+    BiasedCounting* next_queued_ = nullptr;
+    void* block_ = nullptr;
+    ReleaseFn release_ = nullptr;
+};
+
+namespace detail {
+
+inline bool BiasedOwner::Push(BiasedCounting* counts) noexcept {
+    BiasedCounting* head = queue_.load(std::memory_order_acquire);
+    do {
+        if (head == Closed()) {
+            return false;
+        }
+        counts->next_queued_ = head;
+    } while (!queue_.compare_exchange_weak(head, counts, std::memory_order_acq_rel,
+                                           std::memory_order_acquire));
+    return true;
+}
+
+// Only the owner thread drains, and only before it closes the queue
+inline void BiasedOwner::Drain() noexcept {
+    MergeAll(queue_.exchange(nullptr, std::memory_order_acquire));
+}
+
+inline void BiasedOwner::Close() noexcept {
+    MergeAll(queue_.exchange(Closed(), std::memory_order_acq_rel));
+}
+
+inline void BiasedOwner::MergeAll(BiasedCounting* head) noexcept {
+    while (head) {
+        // Merging may free the block, so step past it first
+        BiasedCounting* next = head->next_queued_;
+        head->MergeQueued();
+        head = next;
+    }
+}
+
+}  // namespace detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sharded counts for a few hot, read-mostly objects: every thread counts on its own cache line, so
+// copies don't contend. A main reference (see `ReadMostlyMainPtr`) keeps the object alive while
+// sharded, which is why no decrement has to look at the other shards. Releasing the main
+// reference folds the shards into one atomic counter that is used from then on.
+
+class ShardedCounting {
+public:
+    // Blocks are created by the main pointer, which owns the reference that isn't counted here
+    static constexpr bool kMainReference = true;
+
+    void IncrShared() noexcept {
+        if (ThreadShard().fetch_add(kShardOne, std::memory_order_relaxed) & kFolded) {
+            central_cnt_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    bool DecrShared() noexcept {
+        if (ThreadShard().fetch_sub(kShardOne, std::memory_order_release) & kFolded) {
+            return DecrCentral(1);
+        }
+        return false;
+    }
+    // A snapshot: other threads may be counting meanwhile
+    size_t SharedCount() const noexcept {
+        std::intptr_t count = central_cnt_.load(std::memory_order_relaxed);
+        if (count >= kMainBias / 2) {
+            count -= kMainBias - 1;
+        }
+        for (const Shard& shard : shards_) {
+            const std::intptr_t value = shard.value.load(std::memory_order_relaxed);
+            if (!(value & kFolded)) {
+                count += value >> 1;
+            }
+        }
+        return static_cast<size_t>(count);
+    }
+    // While the main reference exists the object is alive, so a shard increment suffices
+    bool IncrSharedIfNotZero() noexcept {
+        if (!(ThreadShard().fetch_add(kShardOne, std::memory_order_relaxed) & kFolded)) {
+            return true;
+        }
+        std::intptr_t count = central_cnt_.load(std::memory_order_relaxed);
+        do {
+            if (count == 0) {
+                return false;
+            }
+        } while (!central_cnt_.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                                     std::memory_order_relaxed));
+        return true;
+    }
+
+    void IncrWeak() noexcept {
+        weak_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bool DecrWeak() noexcept {
+        if (weak_cnt_.fetch_sub(1, std::memory_order_release) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+    // Folds every shard into the central counter and drops the main reference; returns true
+    // when no other reference is left. The bias keeps the central counter away from zero while
+    // shards are folded one by one, since a reference counted on a shard that is not folded yet
+    // may already be released on one that is.
+    bool ReleaseMain() noexcept {
+        for (Shard& shard : shards_) {
+            const std::intptr_t value = shard.value.exchange(kFolded, std::memory_order_acq_rel);
+            central_cnt_.fetch_add(value >> 1, std::memory_order_relaxed);
+        }
+        return DecrCentral(kMainBias);
+    }
+
+private:
+    static constexpr size_t kShards = 32;
+    // Shards keep the count above a flag bit set once folded; a shard may go negative when a
+    // reference taken on one thread is dropped on another
+    static constexpr std::intptr_t kFolded = 1;
+    static constexpr std::intptr_t kShardOne = 2;
+    static constexpr std::intptr_t kMainBias = std::intptr_t{1} << 48;
+
+    struct alignas(kCacheLineSize) Shard {
+        std::atomic<std::intptr_t> value = 0;
+    };
+
+    std::atomic<std::intptr_t>& ThreadShard() noexcept {
+        static std::atomic<size_t> next_shard = 0;
+        thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+        return shards_[shard % kShards].value;
+    }
+
+    bool DecrCentral(std::intptr_t count) noexcept {
+        if (central_cnt_.fetch_sub(count, std::memory_order_release) == count) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+    Shard shards_[kShards];
+    alignas(kCacheLineSize) std::atomic<std::intptr_t> central_cnt_ = kMainBias;
+    std::atomic<size_t> weak_cnt_ = 1;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Deferred counts: inside a `DeferredCountingScope`, releases are buffered in a thread-local log
+// and applied in bulk when the scope ends or calls `Flush()`; a copy made while the thread has a
+// release of the same block pending cancels it instead of touching the count. Outside a scope the
+// counts behave like `AtomicCounting`.
+//
+// The log only ever holds releases, so the stored count never drops below the real number of
+// references and nothing is destroyed early; an object whose count reaches zero during the flush
+// is destroyed there.
+
+class DeferredCounting;
+
+namespace detail {
+
+class DeferredLog {
+public:
+    static DeferredLog& Current() noexcept {
+        thread_local DeferredLog log;
+        return log;
+    }
+
+    bool Active() const noexcept {
+        return depth_ > 0;
+    }
+    void Enter() noexcept {
+        ++depth_;
+    }
+    void Leave() noexcept {
+        if (depth_ == 1) {
+            Flush();
+        }
+        --depth_;
+    }
+
+    // Pending releases of `counts` by this thread, as a count <= 0; a slot taken by another
+    // block is flushed first
+    std::intptr_t& Pending(DeferredCounting* counts) noexcept;
+    // Nullptr if nothing is pending for `counts`
+    std::intptr_t* FindPending(DeferredCounting* counts) noexcept {
+        Entry& entry = entries_[Slot(counts)];
+        return entry.counts == counts ? &entry.delta : nullptr;
+    }
+
+    // Destructors run by the flush may log new releases, hence the loop
+    void Flush() noexcept;
+
+private:
+    static constexpr size_t kEntries = 64;
+
+    struct Entry {
+        DeferredCounting* counts = nullptr;
+        std::intptr_t delta = 0;
+    };
+
+    static size_t Slot(const DeferredCounting* counts) noexcept {
+        return (reinterpret_cast<std::uintptr_t>(counts) >> 6) % kEntries;
+    }
+
+    static void Apply(Entry entry) noexcept;
+
+    Entry entries_[kEntries];
+    size_t used_ = 0;
+    int depth_ = 0;
+};
+
+}  // namespace detail
+
+class DeferredCounting {
+public:
+    // Releases the block once a flush finds no shared references left; installed by the control
+    // block via `Bind()`
+    using ReleaseFn = void (*)(void* block, bool last_shared) noexcept;
+
+    void Bind(void* block, ReleaseFn release) noexcept {
+        block_ = block;
+        release_ = release;
+    }
+
+    void IncrShared() noexcept {
+        detail::DeferredLog& log = detail::DeferredLog::Current();
+        if (log.Active()) {
+            if (std::intptr_t* pending = log.FindPending(this); pending && *pending < 0) {
+                ++*pending;
+                return;
+            }
+        }
+        shared_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bool DecrShared() noexcept {
+        detail::DeferredLog& log = detail::DeferredLog::Current();
+        if (log.Active()) {
+            --log.Pending(this);
+            return false;
+        }
+        return DecrSharedBy(1);
+    }
+    // Ignores releases still pending in some thread's log
+    size_t SharedCount() const noexcept {
+        return shared_cnt_.load(std::memory_order_relaxed);
+    }
+    bool IncrSharedIfNotZero() noexcept {
+        size_t count = shared_cnt_.load(std::memory_order_relaxed);
+        do {
+            if (count == 0) {
+                return false;
+            }
+        } while (!shared_cnt_.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                                    std::memory_order_relaxed));
+        return true;
+    }
+
+    void IncrWeak() noexcept {
+        weak_cnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+    bool DecrWeak() noexcept {
+        if (weak_cnt_.fetch_sub(1, std::memory_order_release) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    friend class detail::DeferredLog;
+
+    bool DecrSharedBy(size_t count) noexcept {
+        if (shared_cnt_.fetch_sub(count, std::memory_order_release) == count) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+    // The release callback expects the caller to hold a weak reference of its own
+    void ApplyPending(size_t count) noexcept {
+        if (DecrSharedBy(count)) {
+            IncrWeak();
+            release_(block_, true);
+        }
+    }
+
+    std::atomic<size_t> shared_cnt_ = 1;
+    std::atomic<size_t> weak_cnt_ = 1;
+    void* block_ = nullptr;
+    ReleaseFn release_ = nullptr;
+};
+
+namespace detail {
+
+inline std::intptr_t& DeferredLog::Pending(DeferredCounting* counts) noexcept {
+    Entry& entry = entries_[Slot(counts)];
+    // Applying an evicted entry may run destructors that log into this very slot
+    while (entry.counts != counts) {
+        if (!entry.counts) {
+            entry = Entry{counts, 0};
+            ++used_;
+            break;
+        }
+        const Entry evicted = entry;
+        entry = Entry{};
+        --used_;
+        Apply(evicted);
+    }
+    return entry.delta;
+}
+
+inline void DeferredLog::Flush() noexcept {
+    while (used_ > 0) {
+        Entry batch[kEntries];
+        size_t size = 0;
+        for (Entry& entry : entries_) {
+            if (entry.counts) {
+                batch[size++] = entry;
+                entry = Entry{};
+            }
+        }
+        used_ = 0;
+        for (size_t i = 0; i < size; ++i) {
+            Apply(batch[i]);
+        }
+    }
+}
+
+inline void DeferredLog::Apply(Entry entry) noexcept {
+    if (entry.delta < 0) {
+        entry.counts->ApplyPending(static_cast<size_t>(-entry.delta));
+    }
+}
+
+}  // namespace detail
+
+// Buffers releases of `DeferredCounting` blocks on this thread until the outermost scope ends
+class DeferredCountingScope {
+public:
+    DeferredCountingScope() noexcept {
+        detail::DeferredLog::Current().Enter();
+    }
+    ~DeferredCountingScope() {
+        detail::DeferredLog::Current().Leave();
+    }
+
+    DeferredCountingScope(const DeferredCountingScope&) = delete;
+    DeferredCountingScope& operator=(const DeferredCountingScope&) = delete;
+
+    // Epoch boundary: applies everything logged so far
+    static void Flush() noexcept {
+        detail::DeferredLog::Current().Flush();
+    }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "release_sink.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// While alive, final releases on the constructing thread are collected instead of run: objects
+// whose last `SharedPtr` goes away, blocks whose last `WeakPtr` does, and objects of `UniquePtr`s
+// with a stateless deleter. They all run when the scope ends (or on `Flush()`), sorted so that
+// releases of one type run back to back. Releases they trigger in turn are collected and run in
+// the next round.
+//
+// Scopes nest; each one runs what was collected while it was the innermost.
+class DestructionScope : public detail::ReleaseSink {
+public:
+    DestructionScope() : previous_(Install(this)) {
+    }
+
+    DestructionScope(const DestructionScope&) = delete;
+    DestructionScope& operator=(const DestructionScope&) = delete;
+
+    ~DestructionScope() {
+        Flush();
+        Install(previous_);
+    }
+
+    void Defer(void* object, Release release, const void* group) noexcept override {
+        try {
+            pending_.push_back(Pending{object, release, group});
+        } catch (...) {
+            release(object);
+        }
+    }
+
+    void Flush() noexcept {
+        while (!pending_.empty()) {
+            std::vector<Pending> batch;
+            batch.swap(pending_);
+            std::stable_sort(batch.begin(), batch.end(), [](const Pending& a, const Pending& b) {
+                return a.Key() < b.Key();
+            });
+            for (const Pending& pending : batch) {
+                pending.release(pending.object);
+            }
+        }
+    }
+
+private:
+    struct Pending {
+        void* object;
+        Release release;
+        const void* group;
+
+        std::pair<const void*, const void*> Key() const noexcept {
+            return {group, reinterpret_cast<const void*>(release)};
+        }
+    };
+
+    ReleaseSink* previous_;
+    std::vector<Pending> pending_;
+};
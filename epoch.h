@@ -0,0 +1,332 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+#include "thread_state.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Epoch-based (RCU-style) domain. A reader announces the global epoch when it enters a read-side
+// section and clears it on leaving: plain stores, no read-modify-writes. A writer stamps what it
+// unlinks with the current epoch; the epoch advances once every reader inside a section has
+// announced it, and anything stamped two epochs back can no longer be seen by anyone.
+//
+// A domain must outlive every thread that used it. `Synchronize()` must not be called from
+// inside a read-side section.
+class EpochDomain {
+public:
+    EpochDomain() : records_(new Record) {
+        fallback_ = records_;
+    }
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    ~EpochDomain() {
+        detail::ThreadStates<ThreadState>::Forget(this);
+        // Reclaiming may retire into this domain again
+        while (true) {
+            std::vector<Retired> batch;
+            {
+                std::lock_guard lock(retired_mutex_);
+                batch.swap(retired_);
+            }
+            if (batch.empty()) {
+                break;
+            }
+            for (const Retired& retired : batch) {
+                retired.reclaim(retired.object);
+            }
+        }
+        Record* record = records_;
+        while (record) {
+            delete std::exchange(record, record->next);
+        }
+    }
+
+    static EpochDomain& Default() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Readers
+
+    // Sections nest; only the outermost one announces. Threads past destroying their
+    // thread-locals share a fallback record under a lock; it keeps the oldest epoch announced
+    // while any of them is inside, which only holds the epoch back.
+    void Enter() {
+        if (ThreadState* state = LocalState()) {
+            if (state->depth++ == 0) {
+                Announce(*state->record);
+            }
+            return;
+        }
+        std::lock_guard lock(fallback_mutex_);
+        if (fallback_depth_++ == 0) {
+            Announce(*fallback_);
+        }
+    }
+    void Leave() {
+        if (ThreadState* state = LocalState()) {
+            if (--state->depth == 0) {
+                state->record->epoch.store(kQuiescent, std::memory_order_release);
+            }
+            return;
+        }
+        std::lock_guard lock(fallback_mutex_);
+        if (--fallback_depth_ == 0) {
+            fallback_->epoch.store(kQuiescent, std::memory_order_release);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Writers
+
+    // `reclaim(object)` runs once every reader that could have seen `object` has left: on the
+    // first `Retire()`, `Reclaim()` or `Synchronize()` after the epoch has moved two past the
+    // retirement. Each `Retire()` and `Reclaim()` moves it by one unless a reader lags, so a
+    // writer that retires rarely should call `Reclaim()` now and then (or `Synchronize()`) to
+    // bound what stays alive.
+    void Retire(void* object, void (*reclaim)(void*)) {
+        {
+            std::lock_guard lock(retired_mutex_);
+            retired_.push_back(Retired{epoch_.load(std::memory_order_seq_cst), object, reclaim});
+        }
+        Reclaim();
+    }
+
+    // Advances the epoch if it can and reclaims what that made safe; never waits
+    void Reclaim() {
+        TryAdvance();
+        Collect();
+    }
+
+    // Advances the epoch if no reader lags behind it
+    bool TryAdvance() {
+        uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+        {
+            std::lock_guard lock(records_mutex_);
+            for (Record* record = records_; record; record = record->next) {
+                const uint64_t announced = record->epoch.load(std::memory_order_seq_cst);
+                if (announced != kQuiescent && announced != epoch) {
+                    return false;
+                }
+            }
+        }
+        return epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+    }
+
+    // Waits out a full grace period and reclaims everything retired before the call
+    void Synchronize() {
+        const uint64_t target = epoch_.load(std::memory_order_seq_cst) + 2;
+        while (epoch_.load(std::memory_order_seq_cst) < target) {
+            if (!TryAdvance()) {
+                std::this_thread::yield();
+            }
+        }
+        Collect();
+    }
+
+private:
+    struct Record {
+        std::atomic<uint64_t> epoch = kQuiescent;
+        bool active = true;
+        Record* next = nullptr;
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        void* object;
+        void (*reclaim)(void*);
+    };
+
+    struct ThreadState {
+        ThreadState(EpochDomain* domain, Record* own) : owner(domain), record(own) {
+        }
+        ThreadState(ThreadState&& other) noexcept
+            : owner(other.owner), record(std::exchange(other.record, nullptr)),
+              depth(other.depth) {
+        }
+        ThreadState& operator=(ThreadState&& other) noexcept {
+            std::swap(owner, other.owner);
+            std::swap(record, other.record);
+            std::swap(depth, other.depth);
+            return *this;
+        }
+        ~ThreadState() {
+            if (record) {
+                owner->ReleaseRecord(record);
+            }
+        }
+
+        EpochDomain* owner;
+        Record* record;
+        size_t depth = 0;
+    };
+
+    static constexpr uint64_t kQuiescent = 0;
+
+    // Null once the calling thread is past destroying its thread-locals
+    ThreadState* LocalState() {
+        return detail::ThreadStates<ThreadState>::Find(
+            this, [this] { return ThreadState(this, AcquireRecord()); });
+    }
+
+    void Announce(Record& record) noexcept {
+        record.epoch.store(epoch_.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+    }
+
+    Record* AcquireRecord() {
+        std::lock_guard lock(records_mutex_);
+        for (Record* record = records_; record; record = record->next) {
+            if (!record->active) {
+                record->active = true;
+                return record;
+            }
+        }
+        records_ = new Record{.next = records_};
+        return records_;
+    }
+    void ReleaseRecord(Record* record) {
+        std::lock_guard lock(records_mutex_);
+        record->epoch.store(kQuiescent, std::memory_order_release);
+        record->active = false;
+    }
+
+    // Reclaims whatever was retired at least two epochs ago. Stamps are taken under the lock
+    // from a growing epoch, so the list is sorted by them and what is ready is a prefix.
+    void Collect() {
+        const uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+        std::vector<Retired> ready;
+        {
+            std::lock_guard lock(retired_mutex_);
+            auto end = std::partition_point(
+                retired_.begin(), retired_.end(),
+                [epoch](const Retired& retired) { return retired.epoch + 2 <= epoch; });
+            ready.assign(retired_.begin(), end);
+            retired_.erase(retired_.begin(), end);
+        }
+        for (const Retired& retired : ready) {
+            retired.reclaim(retired.object);
+        }
+    }
+
+    std::atomic<uint64_t> epoch_ = 1;
+    std::mutex records_mutex_;
+    Record* records_;
+    // Never handed out by `AcquireRecord()`, which only reuses inactive records
+    Record* fallback_;
+    std::mutex fallback_mutex_;
+    size_t fallback_depth_ = 0;
+    std::mutex retired_mutex_;
+    std::vector<Retired> retired_;
+};
+
+// Read-side section of a domain
+class EpochGuard {
+public:
+    explicit EpochGuard(EpochDomain& domain = EpochDomain::Default()) : domain_(domain) {
+        domain_.Enter();
+    }
+    ~EpochGuard() {
+        domain_.Leave();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+private:
+    EpochDomain& domain_;
+};
+
+// Published `SharedPtr` read under an `EpochGuard` without touching its counts. The slot's own
+// reference to a replaced value, and with it possibly the final `DecrSharedCount`, is dropped
+// after a grace period; writers otherwise get ordinary `SharedPtr`s in and out.
+template <typename T, typename Counting = AtomicCounting>
+class EpochSharedPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    explicit EpochSharedPtr(EpochDomain& domain = EpochDomain::Default())
+        : domain_(domain), node_(nullptr) {
+    }
+    explicit EpochSharedPtr(SharedPtr<T, Counting> value,
+                            EpochDomain& domain = EpochDomain::Default())
+        : domain_(domain), node_(MakeNode(std::move(value))) {
+    }
+
+    EpochSharedPtr(const EpochSharedPtr&) = delete;
+    EpochSharedPtr& operator=(const EpochSharedPtr&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~EpochSharedPtr() {
+        Retire(node_.load(std::memory_order_acquire));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Readers
+
+    // Valid until `guard` goes away
+    T* Get(const EpochGuard&) const noexcept {
+        Node* node = node_.load(std::memory_order_seq_cst);
+        return node ? node->value.Get() : nullptr;
+    }
+
+    // A reference of the caller's own
+    SharedPtr<T, Counting> Load() const {
+        EpochGuard guard(domain_);
+        Node* node = node_.load(std::memory_order_seq_cst);
+        return node ? node->value : SharedPtr<T, Counting>();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Store(SharedPtr<T, Counting> desired) {
+        Retire(node_.exchange(MakeNode(std::move(desired)), std::memory_order_seq_cst));
+    }
+
+    // The old value comes back as a new reference; the slot's own one is dropped later
+    SharedPtr<T, Counting> Exchange(SharedPtr<T, Counting> desired) {
+        Node* old = node_.exchange(MakeNode(std::move(desired)), std::memory_order_seq_cst);
+        SharedPtr<T, Counting> result = old ? old->value : SharedPtr<T, Counting>();
+        Retire(old);
+        return result;
+    }
+
+    void Reset() {
+        Store(SharedPtr<T, Counting>());
+    }
+
+    void Swap(SharedPtr<T, Counting>& other) {
+        other = Exchange(std::move(other));
+    }
+
+private:
+    struct Node {
+        SharedPtr<T, Counting> value;
+    };
+
+    static Node* MakeNode(SharedPtr<T, Counting> value) {
+        return value ? new Node{std::move(value)} : nullptr;
+    }
+
+    void Retire(Node* node) {
+        if (node) {
+            domain_.Retire(node, [](void* object) { delete static_cast<Node*>(object); });
+        }
+    }
+
+    EpochDomain& domain_;
+    std::atomic<Node*> node_;
+};
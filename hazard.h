@@ -0,0 +1,327 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+#include "thread_state.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>  // size_t
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Hazard-pointer domain: readers publish the pointer they are about to use in a hazard record,
+// writers retire what they unlink, and a retired object is reclaimed only once no record holds
+// it. Each thread caches its records and scans for reclaimable objects only after retiring a
+// batch proportional to the number of records, so a scan costs O(threads) per batch. It also scans
+// once what it retired adds up to `max_retired_bytes`, as reported to `Retire()`. A writer that
+// retires rarely can still pin a batch of objects until its next scan; it calls `Scan()` to bound
+// that.
+//
+// A domain must outlive every thread that used it.
+class HazardDomain {
+public:
+    struct Record {
+        std::atomic<const void*> hazard = nullptr;
+        std::atomic<bool> active = true;
+        Record* next = nullptr;
+    };
+
+    explicit HazardDomain(size_t max_retired_bytes = kMaxRetiredBytes)
+        : max_retired_bytes_(max_retired_bytes) {
+    }
+    HazardDomain(const HazardDomain&) = delete;
+    HazardDomain& operator=(const HazardDomain&) = delete;
+
+    ~HazardDomain() {
+        // Reclaiming may retire into this domain again, so hand back and reclaim until quiet
+        while (true) {
+            detail::ThreadStates<ThreadState>::Forget(this);
+            std::vector<Retired> batch;
+            {
+                std::lock_guard lock(orphans_mutex_);
+                batch.swap(orphans_);
+            }
+            if (batch.empty()) {
+                break;
+            }
+            for (const Retired& retired : batch) {
+                retired.reclaim(retired.object);
+            }
+        }
+        Record* record = records_.load(std::memory_order_acquire);
+        while (record) {
+            delete std::exchange(record, record->next);
+        }
+    }
+
+    static HazardDomain& Default() {
+        static HazardDomain domain;
+        return domain;
+    }
+
+    Record* AcquireRecord() {
+        ThreadState* state = LocalState();
+        if (state && !state->records.empty()) {
+            Record* record = state->records.back();
+            state->records.pop_back();
+            return record;
+        }
+        for (Record* record = records_.load(std::memory_order_acquire); record;
+             record = record->next) {
+            bool active = false;
+            if (!record->active.load(std::memory_order_relaxed) &&
+                record->active.compare_exchange_strong(active, true, std::memory_order_acquire)) {
+                return record;
+            }
+        }
+        auto* record = new Record;
+        record->next = records_.load(std::memory_order_relaxed);
+        while (!records_.compare_exchange_weak(record->next, record, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+        record_count_.fetch_add(1, std::memory_order_relaxed);
+        return record;
+    }
+
+    // The record stays with the calling thread for its next hazard pointer
+    void ReleaseRecord(Record* record) {
+        record->hazard.store(nullptr, std::memory_order_release);
+        if (ThreadState* state = LocalState()) {
+            state->records.push_back(record);
+        } else {
+            record->active.store(false, std::memory_order_release);
+        }
+    }
+
+    // `reclaim(object)` runs once no hazard record holds `ptr`; `bytes` is roughly what that
+    // frees
+    void Retire(const void* ptr, void* object, void (*reclaim)(void*), size_t bytes = 0) {
+        ThreadState* state = LocalState();
+        if (!state) {
+            Orphan({Retired{ptr, object, reclaim, bytes}});
+            return;
+        }
+        state->retired.push_back(Retired{ptr, object, reclaim, bytes});
+        state->retired_bytes += bytes;
+        if (state->retired.size() >= ScanThreshold() ||
+            state->retired_bytes >= max_retired_bytes_) {
+            Scan();
+        }
+    }
+
+    // Reclaims every object retired by this thread (or left behind by exited ones) that no
+    // hazard record holds
+    void Scan() {
+        std::vector<Retired> batch;
+        if (ThreadState* state = LocalState()) {
+            batch.swap(state->retired);
+            state->retired_bytes = 0;
+        }
+        {
+            std::lock_guard lock(orphans_mutex_);
+            batch.insert(batch.end(), orphans_.begin(), orphans_.end());
+            orphans_.clear();
+        }
+
+        std::vector<const void*> hazards;
+        for (Record* record = records_.load(std::memory_order_acquire); record;
+             record = record->next) {
+            if (const void* hazard = record->hazard.load(std::memory_order_seq_cst)) {
+                hazards.push_back(hazard);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        // Reclaiming may retire more objects, which land in the thread's list again
+        std::vector<Retired> kept;
+        for (const Retired& retired : batch) {
+            if (std::binary_search(hazards.begin(), hazards.end(), retired.ptr)) {
+                kept.push_back(retired);
+            } else {
+                retired.reclaim(retired.object);
+            }
+        }
+        if (ThreadState* state = LocalState()) {
+            state->retired.insert(state->retired.end(), kept.begin(), kept.end());
+            for (const Retired& retired : kept) {
+                state->retired_bytes += retired.bytes;
+            }
+        } else {
+            Orphan(kept);
+        }
+    }
+
+private:
+    static constexpr size_t kMaxRetiredBytes = size_t{1} << 20;
+
+    struct Retired {
+        const void* ptr;
+        void* object;
+        void (*reclaim)(void*);
+        size_t bytes;
+    };
+
+    // What a thread keeps per domain; handed back to the domain when the thread exits
+    struct ThreadState {
+        explicit ThreadState(HazardDomain* domain) : owner(domain) {
+        }
+        ThreadState(ThreadState&& other) noexcept = default;
+        ThreadState& operator=(ThreadState&& other) noexcept = default;
+        ~ThreadState() {
+            for (Record* record : records) {
+                record->active.store(false, std::memory_order_release);
+            }
+            owner->Orphan(retired);
+        }
+
+        HazardDomain* owner;
+        std::vector<Record*> records;
+        std::vector<Retired> retired;
+        size_t retired_bytes = 0;
+    };
+
+    // Null once the calling thread is past destroying its thread-locals
+    ThreadState* LocalState() {
+        return detail::ThreadStates<ThreadState>::Find(this, [this] { return ThreadState(this); });
+    }
+
+    void Orphan(const std::vector<Retired>& retired) {
+        if (!retired.empty()) {
+            std::lock_guard lock(orphans_mutex_);
+            orphans_.insert(orphans_.end(), retired.begin(), retired.end());
+        }
+    }
+
+    size_t ScanThreshold() const noexcept {
+        return std::max<size_t>(64, 2 * record_count_.load(std::memory_order_relaxed));
+    }
+
+    const size_t max_retired_bytes_;
+    std::atomic<Record*> records_ = nullptr;
+    std::atomic<size_t> record_count_ = 0;
+    std::mutex orphans_mutex_;
+    std::vector<Retired> orphans_;
+};
+
+// Owns one hazard record of a domain for as long as it lives
+class HazardPointer {
+public:
+    explicit HazardPointer(HazardDomain& domain = HazardDomain::Default())
+        : domain_(domain), record_(domain.AcquireRecord()) {
+    }
+    ~HazardPointer() {
+        domain_.ReleaseRecord(record_);
+    }
+
+    HazardPointer(const HazardPointer&) = delete;
+    HazardPointer& operator=(const HazardPointer&) = delete;
+
+    // Publishes the pointer currently in `src` and returns it once it is known to be protected
+    template <typename T>
+    T* Protect(const std::atomic<T*>& src) noexcept {
+        T* ptr = src.load(std::memory_order_relaxed);
+        while (true) {
+            record_->hazard.store(ptr, std::memory_order_seq_cst);
+            T* current = src.load(std::memory_order_seq_cst);
+            if (current == ptr) {
+                return ptr;
+            }
+            ptr = current;
+        }
+    }
+
+    void Reset() noexcept {
+        record_->hazard.store(nullptr, std::memory_order_release);
+    }
+
+private:
+    HazardDomain& domain_;
+    HazardDomain::Record* record_;
+};
+
+// `SharedPtr` slot whose readers use the object through a hazard pointer instead of taking a
+// reference. A replaced value is retired to the domain, so its reference, and with it possibly
+// the final `OnZeroShared`, is dropped only once no reader protects it.
+template <typename T, typename Counting = AtomicCounting>
+class HazardSharedPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    explicit HazardSharedPtr(HazardDomain& domain = HazardDomain::Default())
+        : domain_(domain), node_(nullptr) {
+    }
+    explicit HazardSharedPtr(SharedPtr<T, Counting> value,
+                             HazardDomain& domain = HazardDomain::Default())
+        : domain_(domain), node_(MakeNode(std::move(value))) {
+    }
+
+    HazardSharedPtr(const HazardSharedPtr&) = delete;
+    HazardSharedPtr& operator=(const HazardSharedPtr&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~HazardSharedPtr() {
+        Retire(node_.load(std::memory_order_acquire));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Readers
+
+    // Valid until `hazard` protects something else or goes away
+    T* Protect(HazardPointer& hazard) const noexcept {
+        Node* node = hazard.Protect(node_);
+        return node ? node->value.Get() : nullptr;
+    }
+
+    // A reference of the caller's own
+    SharedPtr<T, Counting> Load() const {
+        HazardPointer hazard(domain_);
+        Node* node = hazard.Protect(node_);
+        return node ? node->value : SharedPtr<T, Counting>();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Writers
+
+    // `bytes` is what dropping `desired` would roughly free once it is replaced; large values
+    // should say so, to have the domain scan for them sooner
+    void Store(SharedPtr<T, Counting> desired, size_t bytes = sizeof(T)) {
+        Retire(node_.exchange(MakeNode(std::move(desired), bytes), std::memory_order_seq_cst));
+    }
+
+    // The old value comes back as a new reference; the slot's own one is retired like on `Store`
+    SharedPtr<T, Counting> Exchange(SharedPtr<T, Counting> desired, size_t bytes = sizeof(T)) {
+        Node* old = node_.exchange(MakeNode(std::move(desired), bytes), std::memory_order_seq_cst);
+        SharedPtr<T, Counting> result = old ? old->value : SharedPtr<T, Counting>();
+        Retire(old);
+        return result;
+    }
+
+    void Reset() {
+        Store(SharedPtr<T, Counting>());
+    }
+
+private:
+    struct Node {
+        SharedPtr<T, Counting> value;
+        size_t bytes;
+    };
+
+    static Node* MakeNode(SharedPtr<T, Counting> value, size_t bytes = sizeof(T)) {
+        return value ? new Node{std::move(value), bytes} : nullptr;
+    }
+
+    void Retire(Node* node) {
+        if (node) {
+            domain_.Retire(
+                node, node, [](void* object) { delete static_cast<Node*>(object); }, node->bytes);
+        }
+    }
+
+    HazardDomain& domain_;
+    std::atomic<Node*> node_;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "release_sink.h"
+
+#include <chrono>
+#include <cstddef>  // size_t
+#include <cstdint>  // SIZE_MAX
+#include <vector>
+
+// Spreads the teardown of large object graphs over several calls. While installed on its thread,
+// every final release (see `detail::ReleaseSink`) lands on a worklist instead of running, so
+// dropping the root of a graph costs one push; `Step()` then destroys objects until its budget
+// runs out, and the children each destruction releases join the worklist rather than recurse.
+//
+// Installed on the constructing thread for its whole life; whatever is left runs on destruction.
+class IncrementalReclaimer : public detail::ReleaseSink {
+public:
+    IncrementalReclaimer() : previous_(Install(this)) {
+    }
+
+    IncrementalReclaimer(const IncrementalReclaimer&) = delete;
+    IncrementalReclaimer& operator=(const IncrementalReclaimer&) = delete;
+
+    ~IncrementalReclaimer() {
+        while (Step(SIZE_MAX)) {
+        }
+        Install(previous_);
+    }
+
+    void Defer(void* object, Release release, const void* /*group*/) noexcept override {
+        try {
+            worklist_.push_back(Item{object, release});
+        } catch (...) {
+            release(object);
+        }
+    }
+
+    // Runs at most `max_count` releases; returns whether any are left
+    bool Step(size_t max_count) noexcept {
+        ReleaseSink* previous = Install(this);
+        for (size_t i = 0; i < max_count && !worklist_.empty(); ++i) {
+            RunOne();
+        }
+        Install(previous);
+        return !worklist_.empty();
+    }
+
+    // Runs releases until `budget` has passed; one that starts in time runs to completion
+    bool Step(std::chrono::nanoseconds budget) noexcept {
+        const auto deadline = std::chrono::steady_clock::now() + budget;
+        ReleaseSink* previous = Install(this);
+        while (!worklist_.empty() && std::chrono::steady_clock::now() < deadline) {
+            RunOne();
+        }
+        Install(previous);
+        return !worklist_.empty();
+    }
+
+    size_t Pending() const noexcept {
+        return worklist_.size();
+    }
+
+private:
+    struct Item {
+        void* object;
+        Release release;
+    };
+
+    // Last in, first out keeps the worklist as short as a depth-first walk of the graph
+    void RunOne() noexcept {
+        const Item item = worklist_.back();
+        worklist_.pop_back();
+        item.release(item.object);
+    }
+
+    ReleaseSink* previous_;
+    std::vector<Item> worklist_;
+};
@@ -0,0 +1,287 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+#include "thread_state.h"
+#include "unique.h"
+
+#include <algorithm>
+#include <cstddef>  // size_t
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Default `Reset` hook of a pool: calls `object.Reset()` if `T` has one
+template <typename T>
+struct PoolReset {
+    void operator()(T& object) const noexcept {
+        if constexpr (requires { object.Reset(); }) {
+            object.Reset();
+        }
+    }
+};
+
+template <typename T, typename Reset = PoolReset<T>>
+class ObjectPool;
+
+// `UniquePtr` deleter that hands the object back to its pool. A default-constructed one belongs
+// to no pool and only lets an empty `UniquePtr` be built.
+template <typename T, typename Reset = PoolReset<T>>
+class PoolDeleter {
+public:
+    PoolDeleter() noexcept = default;
+    explicit PoolDeleter(ObjectPool<T, Reset>& pool) noexcept : pool_(&pool) {
+    }
+
+    void operator()(T* ptr) const noexcept {
+        if (pool_) {
+            pool_->Recycle(ptr);
+        }
+    }
+
+private:
+    ObjectPool<T, Reset>* pool_ = nullptr;
+};
+
+// Pool of constructed objects, for types whose construction and destruction cost more than the
+// allocation. Objects are built with `T()`; once the last pointer to one is dropped, the pool
+// calls `Reset` on it (which must not throw) and keeps it for the next `AcquireShared()` or
+// `AcquireUnique()` instead of destroying it.
+//
+// Each thread keeps up to `thread_cache` idle objects of its own and trades half of them at a
+// time with a shared overflow list. Every `shrink_period` trades the overflow list is cut down
+// to what the period's peak demand needed: objects that sat there the whole period are freed.
+//
+// A pool must outlive every thread that used it and every pointer it handed out.
+template <typename T, typename Reset>
+class ObjectPool {
+public:
+    explicit ObjectPool(size_t thread_cache = 32, size_t shrink_period = 256, Reset reset = Reset())
+        : thread_cache_(thread_cache), shrink_period_(shrink_period ? shrink_period : 1),
+          reset_(std::move(reset)) {
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Freeing an object may recycle the pooled objects it owns back into this pool, so this
+    // drains until neither the thread's state nor the overflow list has any left
+    ~ObjectPool() {
+        for (;;) {
+            const bool forgot = detail::ThreadStates<ThreadState>::Forget(this);
+            std::vector<T*> idle = std::move(idle_);
+            idle_.clear();
+            if (!forgot && idle.empty()) {
+                break;
+            }
+            FreeAll(idle);
+        }
+    }
+
+    template <typename Counting = AtomicCounting>
+    SharedPtr<T, Counting> AcquireShared();
+
+    UniquePtr<T, PoolDeleter<T, Reset>> AcquireUnique() {
+        return UniquePtr<T, PoolDeleter<T, Reset>>(Take(), PoolDeleter<T, Reset>(*this));
+    }
+
+    // Resets `object` and keeps it for reuse
+    void Recycle(T* object) noexcept {
+        reset_(*object);
+        ThreadState* state = LocalState();
+        if (!state || thread_cache_ == 0) {
+            Give(&object, &object + 1);
+            return;
+        }
+        if (state->idle.size() < thread_cache_) {
+            state->idle.push_back(object);
+            return;
+        }
+        // The older half leaves the thread stack before it reaches `Give`: freeing surplus runs
+        // `~T`, which may recycle into this pool or another and move the thread's states
+        const auto half = state->idle.begin() + std::max<size_t>(state->idle.size() / 2, 1);
+        std::vector<T*> spilled;
+        try {
+            spilled.assign(state->idle.begin(), half);
+        } catch (...) {
+            Give(&object, &object + 1);
+            return;
+        }
+        state->idle.erase(state->idle.begin(), half);
+        state->idle.push_back(object);
+        Give(spilled.data(), spilled.data() + spilled.size());
+    }
+
+    // Frees the objects of the overflow list that the current period did not need
+    void Shrink() {
+        std::vector<T*> surplus;
+        {
+            std::lock_guard lock(mutex_);
+            surplus = CutSurplus();
+        }
+        FreeAll(surplus);
+    }
+
+private:
+    // What a thread keeps per pool; handed back to the pool when the thread exits
+    struct ThreadState {
+        explicit ThreadState(ObjectPool* pool) : owner(pool) {
+            idle.reserve(pool->thread_cache_);
+        }
+        ThreadState(ThreadState&& other) noexcept = default;
+        ThreadState& operator=(ThreadState&& other) noexcept = default;
+        ~ThreadState() {
+            owner->Give(idle.data(), idle.data() + idle.size());
+        }
+
+        ObjectPool* owner;
+        std::vector<T*> idle;
+    };
+
+    // Null once the calling thread is past destroying its thread-locals
+    ThreadState* LocalState() noexcept {
+        try {
+            return detail::ThreadStates<ThreadState>::Find(this,
+                                                           [this] { return ThreadState(this); });
+        } catch (...) {
+            return nullptr;
+        }
+    }
+
+    T* Take() {
+        ThreadState* state = LocalState();
+        if (!state) {
+            std::lock_guard lock(mutex_);
+            if (!idle_.empty()) {
+                T* object = idle_.back();
+                idle_.pop_back();
+                low_water_ = std::min(low_water_, idle_.size());
+                return object;
+            }
+            return new T();
+        }
+        T* object = nullptr;
+        std::vector<T*> surplus;
+        if (state->idle.empty()) {
+            surplus = Refill(*state);
+        }
+        if (!state->idle.empty()) {
+            object = state->idle.back();
+            state->idle.pop_back();
+        }
+        // Done with `state`: freeing surplus runs `~T`, which may move the thread's states
+        FreeAll(surplus);
+        return object ? object : new T();
+    }
+
+    // Takes up to half a thread cache from the overflow list; returns what the trade cut from it
+    std::vector<T*> Refill(ThreadState& state) {
+        std::lock_guard lock(mutex_);
+        detail::RefillHalf(state.idle, idle_, thread_cache_);
+        low_water_ = std::min(low_water_, idle_.size());
+        return Tick();
+    }
+
+    static void FreeAll(const std::vector<T*>& objects) noexcept {
+        for (T* object : objects) {
+            delete object;
+        }
+    }
+
+    void Give(T* const* first, T* const* last) noexcept {
+        if (first == last) {
+            return;
+        }
+        std::vector<T*> surplus;
+        bool kept = true;
+        {
+            std::lock_guard lock(mutex_);
+            try {
+                idle_.insert(idle_.end(), first, last);
+            } catch (...) {
+                kept = false;
+            }
+            try {
+                surplus = kept ? Tick() : std::vector<T*>();
+            } catch (...) {
+            }
+        }
+        if (!kept) {
+            // Nowhere to keep them
+            std::for_each(first, last, [](T* object) { delete object; });
+        }
+        FreeAll(surplus);
+    }
+
+    // Called under the lock on every trade with a thread
+    std::vector<T*> Tick() {
+        if (++trades_ < shrink_period_) {
+            return {};
+        }
+        return CutSurplus();
+    }
+
+    // The overflow list never went below `low_water_` this period, so peak demand left that
+    // many untouched; they are the oldest ones
+    std::vector<T*> CutSurplus() {
+        const auto cut = idle_.begin() + std::min(low_water_, idle_.size());
+        std::vector<T*> surplus(idle_.begin(), cut);
+        idle_.erase(idle_.begin(), cut);
+        low_water_ = idle_.size();
+        trades_ = 0;
+        return surplus;
+    }
+
+    const size_t thread_cache_;
+    const size_t shrink_period_;
+    Reset reset_;
+
+    std::mutex mutex_;
+    std::vector<T*> idle_;
+    size_t low_water_ = 0;
+    size_t trades_ = 0;
+};
+
+// Block of a pooled object: dropping the last shared reference recycles the object
+template <typename T, typename Counting, typename Reset>
+struct ControlBlockPooled : ControlBlockBase<Counting> {
+    ControlBlockPooled(ObjectPool<T, Reset>& pool, T* ptr)
+        : ControlBlockBase<Counting>(HookOf<&Manage>()), pool_(pool), p_obj_(ptr) {
+    }
+
+    static void Manage(ControlBlockBase<Counting>* base, BlockOp op) noexcept {
+        auto* self = static_cast<ControlBlockPooled*>(base);
+        if (op == BlockOp::kDestroyObject) {
+            self->pool_.Recycle(self->p_obj_);
+        } else {
+            delete self;
+        }
+    }
+
+    // Blocks come from the calling thread's slabs (see slab.h)
+    static void* operator new(size_t size) {
+        return detail::SlabAllocator::Allocate(size, alignof(ControlBlockPooled));
+    }
+    static void operator delete(void* storage, size_t size) noexcept {
+        detail::SlabAllocator::Deallocate(storage, size, alignof(ControlBlockPooled));
+    }
+
+    ObjectPool<T, Reset>& pool_;
+    T* p_obj_;
+};
+
+template <typename T, typename Reset>
+template <typename Counting>
+SharedPtr<T, Counting> ObjectPool<T, Reset>::AcquireShared() {
+    static_assert(!kHasMainReference<Counting>, "use MakeReadMostly");
+    T* object = Take();
+    ControlBlockPooled<T, Counting, Reset>* block;
+    try {
+        block = new ControlBlockPooled<T, Counting, Reset>(*this, object);
+    } catch (...) {
+        Recycle(object);
+        throw;
+    }
+    return detail::AdoptShared<T, Counting>(block, object);
+}
@@ -0,0 +1,402 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+#include "unique.h"
+#include "release_sink.h"
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>  // int64_t, uint64_t
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace detail {
+
+// Chase-Lev work-stealing deque of releases. The owner pushes and takes at the bottom without
+// locking; other threads steal from the top with one CAS. Outgrown arrays are kept until the deque
+// goes away, since a thief may still be reading one.
+class ReleaseDeque {
+public:
+    struct Item {
+        void* object;
+        ReleaseSink::Release release;
+    };
+
+    ReleaseDeque() {
+        auto array = std::make_unique<Array>(64);
+        array_.store(array.get(), std::memory_order_relaxed);
+        arrays_.push_back(std::move(array));
+    }
+
+    ReleaseDeque(const ReleaseDeque&) = delete;
+    ReleaseDeque& operator=(const ReleaseDeque&) = delete;
+
+    // Owner only; throws when the deque can't grow. Returns whether the deque looked empty.
+    bool Push(Item item) {
+        const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+        const int64_t top = top_.load(std::memory_order_acquire);
+        Array* array = array_.load(std::memory_order_relaxed);
+        if (bottom - top >= static_cast<int64_t>(array->size)) {
+            array = Grow(array, top, bottom);
+        }
+        array->Put(bottom, item);
+        bottom_.store(bottom + 1, std::memory_order_seq_cst);
+        return bottom == top;
+    }
+
+    // Owner only; newest first
+    bool Take(Item& item) noexcept {
+        const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* array = array_.load(std::memory_order_relaxed);
+        bottom_.store(bottom, std::memory_order_seq_cst);
+        int64_t top = top_.load(std::memory_order_seq_cst);
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = array->Get(bottom);
+        if (top == bottom) {
+            // The last item: race the thieves for it
+            const bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                          std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread; oldest first
+    bool Steal(Item& item) noexcept {
+        int64_t top = top_.load(std::memory_order_seq_cst);
+        const int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+        if (top >= bottom) {
+            return false;
+        }
+        // A slot read here is only overwritten after `top_` moves past it, failing the CAS
+        item = array_.load(std::memory_order_acquire)->Get(top);
+        return top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    }
+
+    bool Empty() const noexcept {
+        return top_.load(std::memory_order_seq_cst) >= bottom_.load(std::memory_order_seq_cst);
+    }
+
+private:
+    struct Slot {
+        std::atomic<void*> object;
+        std::atomic<ReleaseSink::Release> release;
+    };
+
+    struct Array {
+        explicit Array(size_t capacity) : size(capacity), slots(new Slot[capacity]) {
+        }
+
+        void Put(int64_t index, Item item) noexcept {
+            Slot& slot = slots[static_cast<size_t>(index) & (size - 1)];
+            slot.object.store(item.object, std::memory_order_relaxed);
+            slot.release.store(item.release, std::memory_order_relaxed);
+        }
+        Item Get(int64_t index) const noexcept {
+            const Slot& slot = slots[static_cast<size_t>(index) & (size - 1)];
+            return Item{slot.object.load(std::memory_order_relaxed),
+                        slot.release.load(std::memory_order_relaxed)};
+        }
+
+        const size_t size;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    Array* Grow(Array* array, int64_t top, int64_t bottom) {
+        auto grown = std::make_unique<Array>(array->size * 2);
+        for (int64_t i = top; i < bottom; ++i) {
+            grown->Put(i, array->Get(i));
+        }
+        arrays_.reserve(arrays_.size() + 1);
+        array = grown.get();
+        arrays_.push_back(std::move(grown));
+        array_.store(array, std::memory_order_release);
+        return array;
+    }
+
+    alignas(kCacheLineSize) std::atomic<int64_t> top_ = 0;
+    alignas(kCacheLineSize) std::atomic<int64_t> bottom_ = 0;
+    std::atomic<Array*> array_;
+    std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+}  // namespace detail
+
+// Pool of threads that tears down large object graphs together. Each worker installs itself as
+// its thread's `detail::ReleaseSink`, so the children a destructor releases land on that worker's
+// own lock-free deque; it works through its deque newest first and steals the oldest entries of
+// the others when it runs dry. Sub-objects shared within the graph are released by whichever
+// thread drops their count to zero, so the graph must use thread-safe counts (not `LocalCounting`).
+//
+// Workers share no counter on the hot path: each counts what it queued and finished on its own
+// cache line. A sleeping worker is woken when a deque turns non-empty, and a thief that leaves
+// more behind wakes the next one. The owner of a deque is always awake, so no item is stranded.
+class ParallelReclaimer {
+public:
+    explicit ParallelReclaimer(size_t threads = std::thread::hardware_concurrency()) {
+        threads = threads ? threads : 1;
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.push_back(std::make_unique<Worker>(*this, i));
+        }
+        threads_.reserve(threads);
+        try {
+            for (auto& worker : workers_) {
+                threads_.emplace_back([this, &worker] { Run(*worker); });
+            }
+        } catch (...) {
+            // Nothing was submitted yet, so the started workers only need to wake up and leave
+            Stop();
+            throw;
+        }
+    }
+
+    ParallelReclaimer(const ParallelReclaimer&) = delete;
+    ParallelReclaimer& operator=(const ParallelReclaimer&) = delete;
+
+    ~ParallelReclaimer() {
+        Wait();
+        Stop();
+    }
+
+    // Drops `root` and waits until the pool is done with everything that released
+    template <typename T, typename Counting>
+    void Teardown(SharedPtr<T, Counting> root) {
+        Collector collector;
+        root.Reset();
+        Submit(collector.items);
+        Wait();
+    }
+    template <typename T, typename Deleter>
+    void Teardown(UniquePtr<T, Deleter> root) {
+        Collector collector;
+        root.Reset();
+        Submit(collector.items);
+        Wait();
+    }
+
+    // Waits until the pool is idle
+    void Wait() noexcept {
+        while (true) {
+            waiters_.fetch_add(1, std::memory_order_seq_cst);
+            const uint64_t idle = idle_.load(std::memory_order_seq_cst);
+            if (Quiescent()) {
+                waiters_.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            idle_.wait(idle, std::memory_order_seq_cst);
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    size_t Threads() const noexcept {
+        return workers_.size();
+    }
+
+private:
+    using Item = detail::ReleaseDeque::Item;
+
+    // Gathers the releases of a teardown on the calling thread
+    struct Collector : detail::ReleaseSink {
+        Collector() : previous(Install(this)) {
+        }
+        ~Collector() {
+            Install(previous);
+        }
+
+        void Defer(void* object, Release release, const void* /*group*/) noexcept override {
+            try {
+                items.push_back(Item{object, release});
+            } catch (...) {
+                release(object);
+            }
+        }
+
+        ReleaseSink* previous;
+        std::vector<Item> items;
+    };
+
+    // Both counts are written by the worker only
+    struct alignas(kCacheLineSize) Worker : detail::ReleaseSink {
+        Worker(ParallelReclaimer& owner, size_t own_index) : pool(owner), index(own_index) {
+        }
+
+        // Counted before it can be stolen, so it never finishes uncounted
+        void Defer(void* object, Release release, const void* /*group*/) noexcept override {
+            const uint64_t count = queued.load(std::memory_order_relaxed);
+            queued.store(count + 1, std::memory_order_seq_cst);
+            bool was_empty;
+            try {
+                was_empty = deque.Push(Item{object, release});
+            } catch (...) {
+                queued.store(count, std::memory_order_seq_cst);
+                release(object);
+                return;
+            }
+            if (was_empty) {
+                pool.Wake();
+            }
+        }
+
+        ParallelReclaimer& pool;
+        const size_t index;
+        detail::ReleaseDeque deque;
+        alignas(kCacheLineSize) std::atomic<uint64_t> queued = 0;
+        std::atomic<uint64_t> finished = 0;
+    };
+
+    // Roots go to a shared inbox that idle workers take from in batches
+    void Submit(const std::vector<Item>& items) {
+        if (items.empty()) {
+            return;
+        }
+        try {
+            std::lock_guard lock(inbox_mutex_);
+            inbox_.insert(inbox_.end(), items.begin(), items.end());
+            submitted_.fetch_add(items.size(), std::memory_order_seq_cst);
+            inbox_size_.store(inbox_.size(), std::memory_order_seq_cst);
+        } catch (...) {
+            for (const Item& item : items) {
+                item.release(item.object);
+            }
+            return;
+        }
+        work_.fetch_add(1, std::memory_order_seq_cst);
+        work_.notify_all();
+    }
+
+    // Everything queued so far has finished. Finished counts are read first: an item finishes
+    // after it and its children were queued, so the sums only match once nothing is in flight.
+    bool Quiescent() const noexcept {
+        uint64_t finished = 0;
+        for (const auto& worker : workers_) {
+            finished += worker->finished.load(std::memory_order_seq_cst);
+        }
+        uint64_t queued = submitted_.load(std::memory_order_seq_cst);
+        for (const auto& worker : workers_) {
+            queued += worker->queued.load(std::memory_order_seq_cst);
+        }
+        return queued == finished;
+    }
+
+    void Wake() noexcept {
+        if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+            work_.fetch_add(1, std::memory_order_seq_cst);
+            work_.notify_one();
+        }
+    }
+
+    bool Take(Worker& self, Item& item) {
+        if (self.deque.Take(item)) {
+            return true;
+        }
+        for (size_t i = 1; i < workers_.size(); ++i) {
+            detail::ReleaseDeque& victim = workers_[(self.index + i) % workers_.size()]->deque;
+            if (victim.Steal(item)) {
+                // Pass the wake-up on while there is more to steal
+                if (!victim.Empty()) {
+                    Wake();
+                }
+                return true;
+            }
+        }
+        return TakeInbox(self, item);
+    }
+
+    // Takes a fair share of the inbox; what doesn't fit in the deque stays there
+    bool TakeInbox(Worker& self, Item& item) {
+        if (inbox_size_.load(std::memory_order_seq_cst) == 0) {
+            return false;
+        }
+        std::lock_guard lock(inbox_mutex_);
+        if (inbox_.empty()) {
+            return false;
+        }
+        item = inbox_.back();
+        inbox_.pop_back();
+        size_t share = inbox_.size() / workers_.size();
+        try {
+            for (; share > 0; --share) {
+                self.deque.Push(inbox_.back());
+                inbox_.pop_back();
+            }
+        } catch (...) {
+        }
+        inbox_size_.store(inbox_.size(), std::memory_order_seq_cst);
+        if (!inbox_.empty()) {
+            Wake();
+        }
+        return true;
+    }
+
+    void Finish(Worker& self, Item item) noexcept {
+        item.release(item.object);
+        self.finished.store(self.finished.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_seq_cst);
+    }
+
+    // Lets `Wait()` recheck once a worker runs dry
+    void NotifyIdle() noexcept {
+        if (waiters_.load(std::memory_order_seq_cst) > 0) {
+            idle_.fetch_add(1, std::memory_order_seq_cst);
+            idle_.notify_all();
+        }
+    }
+
+    void Stop() noexcept {
+        stop_.store(true, std::memory_order_seq_cst);
+        work_.fetch_add(1, std::memory_order_seq_cst);
+        work_.notify_all();
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void Run(Worker& self) {
+        detail::ReleaseSink::Install(&self);
+        while (true) {
+            const uint64_t work = work_.load(std::memory_order_seq_cst);
+            Item item;
+            if (Take(self, item)) {
+                Finish(self, item);
+                continue;
+            }
+            NotifyIdle();
+            if (stop_.load(std::memory_order_seq_cst)) {
+                return;
+            }
+            // Announce the sleep, then look once more: a push that missed the announcement is
+            // visible to this look
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            if (Take(self, item)) {
+                sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                Finish(self, item);
+                continue;
+            }
+            work_.wait(work, std::memory_order_seq_cst);
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex inbox_mutex_;
+    std::vector<Item> inbox_;
+    std::atomic<size_t> inbox_size_ = 0;
+    std::atomic<uint64_t> submitted_ = 0;
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> work_ = 0;
+    std::atomic<size_t> sleepers_ = 0;
+    std::atomic<bool> stop_ = false;
+    alignas(kCacheLineSize) std::atomic<uint64_t> idle_ = 0;
+    std::atomic<size_t> waiters_ = 0;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+
+#include <cstddef>  // std::nullptr_t
+#include <utility>
+
+// Owner of a hot, read-mostly object (schema, feature flags). Readers take `ReadMostlySharedPtr`
+// copies, which count on per-thread shards; the shards are summed only once the main pointer is
+// reset, after which the remaining copies count on a single atomic.
+template <typename T>
+class ReadMostlyMainPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ReadMostlyMainPtr() : raw_ptr_(nullptr) {
+    }
+    ReadMostlyMainPtr(std::nullptr_t) : raw_ptr_(nullptr) {
+    }
+
+    ReadMostlyMainPtr(ReadMostlyMainPtr&& other) noexcept {
+        p_ctrl_block_ = other.p_ctrl_block_;
+        raw_ptr_ = other.raw_ptr_;
+        other.p_ctrl_block_ = nullptr;
+        other.raw_ptr_ = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    ReadMostlyMainPtr& operator=(ReadMostlyMainPtr&& other) noexcept {
+        ReadMostlyMainPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~ReadMostlyMainPtr() {
+        if (p_ctrl_block_ && p_ctrl_block_->counts_.ReleaseMain()) {
+            p_ctrl_block_->OnZeroShared();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() noexcept {
+        ReadMostlyMainPtr().Swap(*this);
+    }
+
+    void Swap(ReadMostlyMainPtr& other) noexcept {
+        std::swap(p_ctrl_block_, other.p_ctrl_block_);
+        std::swap(raw_ptr_, other.raw_ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // A copy for readers; counts on the calling thread's shard
+    ReadMostlySharedPtr<T> GetShared() const noexcept {
+        ReadMostlySharedPtr<T> result;
+        if (p_ctrl_block_) {
+            p_ctrl_block_->IncrSharedCount();
+            result.p_ctrl_block_ = p_ctrl_block_;
+            result.raw_ptr_ = raw_ptr_;
+        }
+        return result;
+    }
+
+    T* Get() const {
+        return raw_ptr_;
+    }
+    std::add_lvalue_reference_t<T> operator*() const {
+        return *Get();
+    }
+    T* operator->() const {
+        return Get();
+    }
+    explicit operator bool() const {
+        return Get() == nullptr ? false : true;
+    }
+
+    template <typename Y, typename... Args>
+    friend ReadMostlyMainPtr<Y> MakeReadMostly(Args&&... args);
+
+    // Ban copying
+
+    ReadMostlyMainPtr& operator=(const ReadMostlyMainPtr&) = delete;
+    ReadMostlyMainPtr(const ReadMostlyMainPtr&) = delete;
+
+private:
+    ControlBlockBase<ShardedCounting>* p_ctrl_block_ = nullptr;
+    T* raw_ptr_;
+};
+
+// Allocate memory only once
+template <typename T, typename... Args>
+ReadMostlyMainPtr<T> MakeReadMostly(Args&&... args) {
+    auto* block = new ControlBlockMakeShared<T, ShardedCounting>;
+    T* ptr;
+    try {
+        ptr = new (block->Object()) T(std::forward<Args>(args)...);
+    } catch (...) {
+        // Nothing refers to the block yet, and there is no object to destroy
+        delete block;
+        throw;
+    }
+    auto result = ReadMostlyMainPtr<T>();
+    result.p_ctrl_block_ = block;
+    result.raw_ptr_ = ptr;
+    return result;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+#include "bounded_queue.h"
+#include "block_reserve.h"
+#include "release_sink.h"
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdlib>  // std::malloc, std::free, std::aligned_alloc
+#include <new>
+
+// Final releases handed off by real-time threads, run by whoever calls `Drain()` (never a
+// real-time thread)
+class RealtimeReleaseQueue {
+public:
+    explicit RealtimeReleaseQueue(size_t capacity = 4096) : queue_(capacity) {
+    }
+
+    RealtimeReleaseQueue(const RealtimeReleaseQueue&) = delete;
+    RealtimeReleaseQueue& operator=(const RealtimeReleaseQueue&) = delete;
+
+    // Lives as long as the program, so real-time threads may release until the very end
+    static RealtimeReleaseQueue& Default() {
+        static auto* queue = new RealtimeReleaseQueue;
+        return *queue;
+    }
+
+    // Returns how many releases it ran
+    size_t Drain() noexcept {
+        size_t count = 0;
+        Item item;
+        while (queue_.TryPop(item)) {
+            item.release(item.object);
+            ++count;
+        }
+        return count;
+    }
+
+    // Releases that found the queue full and ran on the real-time thread
+    size_t Overflows() const noexcept {
+        return overflows_.load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class RealtimeScope;
+
+    struct Item {
+        void* object;
+        detail::ReleaseSink::Release release;
+    };
+
+    void Push(void* object, detail::ReleaseSink::Release release) noexcept {
+        if (!queue_.TryPush(Item{object, release})) {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            release(object);
+        }
+    }
+
+    detail::BoundedQueue<Item> queue_;
+    std::atomic<size_t> overflows_ = 0;
+};
+
+// Marks its thread as real-time while alive. Final releases made there (objects whose last
+// `SharedPtr` goes away, blocks whose last `WeakPtr` does, objects of `UniquePtr`s with a
+// stateless deleter) go to a `RealtimeReleaseQueue` instead of running, and `MakeShared` takes
+// its block from the storage set aside by `ReserveRealtime`. Only when either runs out does the
+// thread reach the allocator.
+class RealtimeScope : public detail::ReleaseSink {
+public:
+    explicit RealtimeScope(RealtimeReleaseQueue& queue = RealtimeReleaseQueue::Default())
+        : queue_(queue), previous_(Install(this)) {
+        detail::RealtimeContext::Enter();
+    }
+
+    RealtimeScope(const RealtimeScope&) = delete;
+    RealtimeScope& operator=(const RealtimeScope&) = delete;
+
+    ~RealtimeScope() {
+        detail::RealtimeContext::Leave();
+        Install(previous_);
+    }
+
+    void Defer(void* object, Release release, const void* /*group*/) noexcept override {
+        queue_.Push(object, release);
+    }
+
+private:
+    RealtimeReleaseQueue& queue_;
+    ReleaseSink* previous_;
+};
+
+// Sets aside storage for `count` blocks of `MakeShared<T, Counting>` for real-time threads. Call
+// it from a thread that may allocate; the first call for a type fixes how many blocks are kept.
+template <typename T, typename Counting = AtomicCounting>
+void ReserveRealtime(size_t count) {
+    using Block = ControlBlockMakeShared<T, Counting>;
+    Block::Storage::Reserve(count);
+    // Registers the block type now rather than on the first real-time `MakeShared`
+    HookOf<&Block::Manage>();
+}
+
+// Called when a real-time thread reaches the allocator anyway; `std::abort` by default
+inline void SetRealtimeAllocationTrap(void (*trap)()) noexcept {
+    detail::RealtimeContext::SetTrap(trap);
+}
+
+// Define SMART_PTRS_TRAP_REALTIME_ALLOCATIONS in exactly one translation unit before including
+// this header to replace the global allocation functions with ones that fire the trap
+#ifdef SMART_PTRS_TRAP_REALTIME_ALLOCATIONS
+
+void* operator new(size_t size) {
+    detail::RealtimeContext::OnAllocation();
+    if (void* storage = std::malloc(size ? size : 1)) {
+        return storage;
+    }
+    throw std::bad_alloc();
+}
+void* operator new(size_t size, std::align_val_t align) {
+    detail::RealtimeContext::OnAllocation();
+    const auto alignment = static_cast<size_t>(align);
+    const size_t rounded = (size + alignment - 1) / alignment * alignment;
+    if (void* storage = std::aligned_alloc(alignment, rounded ? rounded : alignment)) {
+        return storage;
+    }
+    throw std::bad_alloc();
+}
+// The non-throwing forms come from the same functions, so everything is freed by `std::free`
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size, align);
+    } catch (...) {
+        return nullptr;
+    }
+}
+// GCC sees `std::free` of what it takes for an `operator new` result; both are the ones above
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* storage) noexcept {
+    if (storage) {
+        detail::RealtimeContext::OnAllocation();
+    }
+    std::free(storage);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+void operator delete(void* storage, size_t) noexcept {
+    operator delete(storage);
+}
+void operator delete(void* storage, std::align_val_t) noexcept {
+    operator delete(storage);
+}
+void operator delete(void* storage, size_t, std::align_val_t) noexcept {
+    operator delete(storage);
+}
+void operator delete(void* storage, const std::nothrow_t&) noexcept {
+    operator delete(storage);
+}
+void operator delete(void* storage, std::align_val_t, const std::nothrow_t&) noexcept {
+    operator delete(storage);
+}
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace detail {
+
+// Takes over the final releases made on its thread while installed: the destruction of an object
+// whose last owner is gone (`OnZeroShared`, `UniquePtr` deleters) and the freeing of a control
+// block (`OnZeroWeak`). See destruction_scope.h.
+class ReleaseSink {
+public:
+    using Release = void (*)(void*) noexcept;
+
+    // `release(object)` finishes the release. Releases of the same kind share a `group`, so a
+    // sink may run them side by side.
+    virtual void Defer(void* object, Release release, const void* group) noexcept = 0;
+
+    static ReleaseSink* Current() noexcept {
+        return current_;
+    }
+    // Returns the sink installed before
+    static ReleaseSink* Install(ReleaseSink* sink) noexcept {
+        return std::exchange(current_, sink);
+    }
+
+protected:
+    ~ReleaseSink() = default;
+
+private:
+    static inline thread_local ReleaseSink* current_ = nullptr;
+};
+
+// Runs the releases made while it is installed in a loop when it goes away, so an object whose
+// destructor releases the next one (and so on down a chain) is torn down without recursion
+class ReleaseWorklist : public ReleaseSink {
+public:
+    ReleaseWorklist() : previous_(Install(this)) {
+    }
+
+    ReleaseWorklist(const ReleaseWorklist&) = delete;
+    ReleaseWorklist& operator=(const ReleaseWorklist&) = delete;
+
+    ~ReleaseWorklist() {
+        while (!worklist_.empty()) {
+            const Item item = worklist_.back();
+            worklist_.pop_back();
+            item.release(item.object);
+        }
+        Install(previous_);
+    }
+
+    // Usually called by a node's destructor with the next node of the chain, which runs as soon as
+    // the current release returns; it loads while the current node is freed
+    void Defer(void* object, Release release, const void* /*group*/) noexcept override {
+        __builtin_prefetch(object);
+        try {
+            worklist_.push_back(Item{object, release});
+        } catch (...) {
+            release(object);
+        }
+    }
+
+private:
+    struct Item {
+        void* object;
+        Release release;
+    };
+
+    ReleaseSink* previous_;
+    std::vector<Item> worklist_;
+};
+
+}  // namespace detail
+
+// Specialize to `std::true_type` for node types that own the next node of a long chain (through
+// `SharedPtr<T>` or `UniquePtr<T>`). Dropping a pointer to such a node then frees the whole chain
+// in a loop instead of recursing once per node. Declare the specialization before the node type
+// is defined.
+template <typename T>
+struct IterativeDestruction : std::false_type {};
+
+template <typename T>
+inline constexpr bool kIterativeDestruction = IterativeDestruction<std::remove_cv_t<T>>::value;
@@ -1,86 +1,315 @@
 #pragma once
 
 #include "sw_fwd.h"  // Forward declaration
+#include "counting.h"
+#include "release_sink.h"
+#include "block_reserve.h"
 
+#include <atomic>
 #include <cstddef>  // std::nullptr_t
+#include <cstdint>  // uint16_t
+#include <new>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 
-struct ControlBlockBase {
-    virtual ~ControlBlockBase() = default;
-    virtual void OnZeroShared() = 0;
-    virtual void OnZeroWeak() = 0;
-    virtual void IncrSharedCount() = 0;
-    virtual void DecrSharedCount() = 0;
-    virtual size_t GetSharedCount() const = 0;
+// Counts that may finish a release outside of `DecrSharedCount` (see `BiasedCounting`) call back
+// into the block through `Block::ReleaseDeferred`
+template <typename Counting, typename Block>
+void BindCounts(Counting& counts, Block* block) {
+    if constexpr (requires { counts.Bind(block, &Block::ReleaseDeferred); }) {
+        counts.Bind(block, &Block::ReleaseDeferred);
+    }
+}
+
+// Counts with a main reference (see `ShardedCounting`) are only created through their main pointer
+template <typename Counting>
+inline constexpr bool kHasMainReference = requires { Counting::kMainReference; };
+
+// The only type-dependent operations of a control block
+enum class BlockOp { kDestroyObject, kDeallocate };
+
+// Counts that keep a type tag (see counting.h) let the block find its manager by it
+template <typename Counting>
+inline constexpr bool kKeepsTag = requires(Counting& counts, uint16_t tag) {
+    counts.SetTag(tag);
+    counts.Tag();
 };
 
-template <typename T>
-struct ControlBlockPtr : ControlBlockBase {
-    ControlBlockPtr(T* ptr) : p_obj_(ptr) {
+namespace detail {
+
+// Every manager with a tag, indexed by it. Tags are handed out once per block type and never
+// reused. The table has static storage, so registering neither locks nor allocates and may run on
+// any thread, even one that must not allocate; pages of tags never handed out are never touched.
+//
+// There is one table per tag-keeping policy (`LocalCounting` and `AtomicCounting`), each 2^16
+// pointers (512 KiB) of zero-initialized storage: the address space a 16-bit tag can name, of
+// which a program only commits the pages its block types land on.
+template <typename Manager>
+class ManagerTable {
+public:
+    static uint16_t Register(Manager manage) {
+        const size_t tag = size_.fetch_add(1, std::memory_order_relaxed);
+        if (tag >= kCapacity) {
+            throw std::length_error("too many control block types");
+        }
+        managers_[tag] = manage;
+        return static_cast<uint16_t>(tag);
     }
-    void IncrSharedCount() override {
-        shared_cnt_++;
+
+    // The block holding `tag` was built after its manager was registered, and whoever reaches
+    // the block is ordered after its construction
+    static Manager Get(uint16_t tag) noexcept {
+        return managers_[tag];
     }
-    void DecrSharedCount() override {
-        --shared_cnt_;
-        if (shared_cnt_ == 0 && weak_cnt_ == 0) {
-            OnZeroShared();
-            OnZeroWeak();
-        } else if (shared_cnt_ == 0) {
+
+private:
+    static constexpr size_t kCapacity = size_t{1} << 16;
+
+    static inline std::atomic<size_t> size_ = 0;
+    static inline Manager managers_[kCapacity] = {};
+};
+
+}  // namespace detail
+
+// What a concrete block hands its base: the manager, and its tag if the counts keep one
+template <typename Manager>
+struct ManagerHook {
+    Manager manage;
+    uint16_t tag = 0;
+};
+
+// Counting is type-independent and stays inline; the concrete block provides a single hook that
+// destroys the object or frees the block. A hook may defer `kDestroyObject` by taking a weak
+// reference first and dropping it once the object is gone.
+//
+// Blocks whose counts keep a type tag find the hook through it and are a pointer smaller; the
+// others store the hook itself. Only `LocalCounting` and `AtomicCounting` keep one, in the top
+// bits of their weak count; the other policies need every bit of their counts or keep more than
+// plain counts, so their blocks keep the pointer.
+template <typename Counting>
+struct ControlBlockBase {
+    using Manager = void (*)(ControlBlockBase*, BlockOp) noexcept;
+
+    // Concrete blocks pass `HookOf<&Manage>()`
+    explicit ControlBlockBase(ManagerHook<Manager> hook) {
+        if constexpr (kKeepsTag<Counting>) {
+            counts_.SetTag(hook.tag);
+        } else {
+            manage_ = hook.manage;
+        }
+        BindCounts(counts_, this);
+    }
+
+    void IncrSharedCount() noexcept {
+        counts_.IncrShared();
+    }
+    void DecrSharedCount() noexcept {
+        if constexpr (requires { counts_.ReleaseIfLast(); }) {
+            if (counts_.ReleaseIfLast() && !detail::ReleaseSink::Current()) {
+                const Manager manage = GetManager();
+                manage(this, BlockOp::kDestroyObject);
+                if (counts_.ReleaseIfLast()) {
+                    manage(this, BlockOp::kDeallocate);
+                } else {
+                    // The manager kept a weak reference to finish the destruction later
+                    counts_.DecrShared();
+                    if (counts_.DecrWeak()) {
+                        OnZeroWeak(manage);
+                    }
+                }
+                return;
+            }
+        }
+        if (counts_.DecrShared()) {
             OnZeroShared();
         }
     }
-    size_t GetSharedCount() const override {
-        return shared_cnt_;
+    size_t GetSharedCount() const noexcept {
+        return counts_.SharedCount();
+    }
+    // Fails once the object is gone
+    bool TryIncrSharedCount() noexcept {
+        return counts_.IncrSharedIfNotZero();
     }
-    size_t weak_cnt_ = 0;
-    size_t shared_cnt_ = 1;
-    T* p_obj_;
 
-    void OnZeroShared() override {
-        delete p_obj_;
+    void IncrWeakCount() noexcept {
+        counts_.IncrWeak();
+    }
+    void DecrWeakCount() noexcept {
+        if (counts_.DecrWeak()) {
+            OnZeroWeak(GetManager());
+        }
     }
 
-    void OnZeroWeak() override {
-        delete this;
+    // Shared owners hold one weak reference between them, dropped once the object is gone.
+    // Both releases go to the thread's `ReleaseSink` if one is installed.
+    //
+    // A release looks the manager up once and passes it on: behind a tag, reading it again right
+    // after the weak count's decrement would wait for that decrement.
+    void OnZeroShared() noexcept {
+        const Manager manage = GetManager();
+        if (detail::ReleaseSink* sink = detail::ReleaseSink::Current()) {
+            sink->Defer(this, &ReleaseObject, reinterpret_cast<const void*>(manage));
+            return;
+        }
+        DestroyObject(manage);
+    }
+    void OnZeroWeak(Manager manage) noexcept {
+        if (detail::ReleaseSink* sink = detail::ReleaseSink::Current()) {
+            sink->Defer(this, &ReleaseBlock, reinterpret_cast<const void*>(manage));
+            return;
+        }
+        manage(this, BlockOp::kDeallocate);
+    }
+    void DestroyObject(Manager manage) noexcept {
+        manage(this, BlockOp::kDestroyObject);
+        if (counts_.DecrWeak()) {
+            OnZeroWeak(manage);
+        }
     }
 
-    ~ControlBlockPtr() override = default;
-};
+    Manager GetManager() const noexcept {
+        if constexpr (kKeepsTag<Counting>) {
+            return detail::ManagerTable<Manager>::Get(counts_.Tag());
+        } else {
+            return manage_;
+        }
+    }
 
-template <typename T, typename... Args>
-struct ControlBlockMakeShared : ControlBlockBase {
-    ControlBlockMakeShared() {
+    static void ReleaseObject(void* block) noexcept {
+        auto* self = static_cast<ControlBlockBase*>(block);
+        self->DestroyObject(self->GetManager());
     }
-    void IncrSharedCount() override {
-        shared_cnt_++;
+    static void ReleaseBlock(void* block) noexcept {
+        auto* self = static_cast<ControlBlockBase*>(block);
+        self->GetManager()(self, BlockOp::kDeallocate);
     }
-    void DecrSharedCount() override {
-        --shared_cnt_;
-        if (shared_cnt_ == 0 && weak_cnt_ == 0) {
-            OnZeroShared();
-            OnZeroWeak();
-        } else if (shared_cnt_ == 0) {
-            OnZeroShared();
+
+    // The deferring side holds a weak reference of its own until it gets here
+    static void ReleaseDeferred(void* block, bool last_shared) noexcept {
+        auto* self = static_cast<ControlBlockBase*>(block);
+        if (last_shared) {
+            self->OnZeroShared();
         }
+        self->DecrWeakCount();
+    }
+
+    struct NoManager {};
+
+    Counting counts_;
+    [[no_unique_address]] std::conditional_t<kKeepsTag<Counting>, NoManager, Manager> manage_;
+};
+
+namespace detail {
+
+template <typename Manager>
+struct CountingOf;
+
+template <typename Counting>
+struct CountingOf<void (*)(ControlBlockBase<Counting>*, BlockOp) noexcept> {
+    using Type = Counting;
+};
+
+}  // namespace detail
+
+// Registers `Manage` the first time a block of its type is built (see `ManagerTable`)
+template <auto Manage>
+ManagerHook<decltype(Manage)> HookOf() {
+    using Manager = decltype(Manage);
+    if constexpr (kKeepsTag<typename detail::CountingOf<Manager>::Type>) {
+        static const uint16_t tag = detail::ManagerTable<Manager>::Register(Manage);
+        return {Manage, tag};
+    } else {
+        return {Manage};
     }
-    size_t GetSharedCount() const override {
-        return shared_cnt_;
+}
+
+template <typename T, typename Counting>
+struct ControlBlockPtr : ControlBlockBase<Counting> {
+    ControlBlockPtr(T* ptr) : ControlBlockBase<Counting>(HookOf<&Manage>()), p_obj_(ptr) {
     }
-    size_t weak_cnt_ = 0;
-    size_t shared_cnt_ = 1;
-    std::aligned_storage_t<sizeof(T), alignof(T)> holder_;
 
-    void OnZeroShared() override {
-        reinterpret_cast<T*>(&holder_)->~T();
+    static void Manage(ControlBlockBase<Counting>* base, BlockOp op) noexcept {
+        auto* self = static_cast<ControlBlockPtr*>(base);
+        if (op == BlockOp::kDestroyObject) {
+            delete self->p_obj_;
+        } else {
+            delete self;
+        }
     }
 
-    void OnZeroWeak() override {
-        delete this;
+    // Blocks come from the calling thread's slabs (see slab.h)
+    static void* operator new(size_t size) {
+        return detail::SlabAllocator::Allocate(size, alignof(ControlBlockPtr));
+    }
+    static void operator delete(void* storage, size_t size) noexcept {
+        detail::SlabAllocator::Deallocate(storage, size, alignof(ControlBlockPtr));
     }
+
+    T* p_obj_;
 };
 
+// Specialize to `std::true_type` to keep the counts and the object of `MakeShared<T>` on separate
+// cache lines. Worth the padding when the object is written while other threads copy pointers to
+// it, since every count update would otherwise invalidate the object's line.
 template <typename T>
+struct IsolateControlBlock : std::false_type {};
+
+template <typename T>
+inline constexpr size_t kObjectAlignment =
+    IsolateControlBlock<T>::value && alignof(T) < kCacheLineSize ? kCacheLineSize : alignof(T);
+
+template <typename T, typename Counting>
+struct ControlBlockMakeShared : ControlBlockBase<Counting> {
+    using Hook = ManagerHook<typename ControlBlockBase<Counting>::Manager>;
+
+    explicit ControlBlockMakeShared(Hook hook = HookOf<&Manage>())
+        : ControlBlockBase<Counting>(hook) {
+    }
+
+    static void Manage(ControlBlockBase<Counting>* base, BlockOp op) noexcept {
+        auto* self = static_cast<ControlBlockMakeShared*>(base);
+        if (op == BlockOp::kDestroyObject) {
+            self->Object()->~T();
+        } else {
+            delete self;
+        }
+    }
+
+    T* Object() noexcept {
+        return reinterpret_cast<T*>(&holder_);
+    }
+
+    // Blocks come from the thread's recycled ones if enabled (see `SetRecycleCapacity`), else
+    // from its slabs (see slab.h); real-time threads take them from the reserve (see realtime.h)
+    using Storage = detail::BlockReserve<ControlBlockMakeShared>;
+
+    static void* operator new(size_t size) {
+        return Storage::Allocate(size, alignof(ControlBlockMakeShared));
+    }
+    static void* operator new(size_t size, std::align_val_t align) {
+        return Storage::Allocate(size, static_cast<size_t>(align));
+    }
+    static void operator delete(void* storage, size_t size) noexcept {
+        Storage::Deallocate(storage, size, alignof(ControlBlockMakeShared));
+    }
+    static void operator delete(void* storage, size_t size, std::align_val_t align) noexcept {
+        Storage::Deallocate(storage, size, static_cast<size_t>(align));
+    }
+
+    alignas(kObjectAlignment<T>) std::aligned_storage_t<sizeof(T), alignof(T)> holder_;
+};
+
+namespace detail {
+
+// Wraps a block that already counts one shared reference to `ptr`
+template <typename T, typename Counting>
+SharedPtr<T, Counting> AdoptShared(ControlBlockBase<Counting>* block, T* ptr) noexcept;
+
+}  // namespace detail
+
+template <typename T, typename Counting>
 class SharedPtr {
 public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -93,12 +322,14 @@ public:
 
     template <typename Y>
     explicit SharedPtr(Y* ptr) {
-        p_ctrl_block_ = new ControlBlockPtr<Y>(ptr);
+        static_assert(!kHasMainReference<Counting>);
+        p_ctrl_block_ = new ControlBlockPtr<Y, Counting>(ptr);
         raw_ptr_ = ptr;
     }
 
     explicit SharedPtr(T* ptr) {
-        p_ctrl_block_ = new ControlBlockPtr<T>(ptr);
+        static_assert(!kHasMainReference<Counting>);
+        p_ctrl_block_ = new ControlBlockPtr<T, Counting>(ptr);
         raw_ptr_ = ptr;
     }
 
@@ -113,7 +344,7 @@ public:
     }
 
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other) noexcept {
+    SharedPtr(const SharedPtr<Y, Counting>& other) noexcept {
         if (!other) {
             raw_ptr_ = nullptr;
         } else {
@@ -131,7 +362,7 @@ public:
     }
 
     template <typename Y>
-    SharedPtr(SharedPtr<Y>&& other) noexcept {
+    SharedPtr(SharedPtr<Y, Counting>&& other) noexcept {
         p_ctrl_block_ = other.p_ctrl_block_;
         raw_ptr_ = other.raw_ptr_;
         other.p_ctrl_block_ = nullptr;
@@ -141,7 +372,7 @@ public:
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) {
+    SharedPtr(const SharedPtr<Y, Counting>& other, T* ptr) {
         if (!other) {
             raw_ptr_ = nullptr;
         }
@@ -152,30 +383,30 @@ public:
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other);
+    explicit SharedPtr(const WeakPtr<T, Counting>& other);
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
 
     SharedPtr& operator=(const SharedPtr& other) {
-        SharedPtr<T>(other).Swap(*this);
+        SharedPtr(other).Swap(*this);
         return *this;
     }
 
     template <typename Y>
-    SharedPtr& operator=(const SharedPtr<Y>& other) {
-        SharedPtr<T>(other).Swap(*this);
+    SharedPtr& operator=(const SharedPtr<Y, Counting>& other) {
+        SharedPtr(other).Swap(*this);
         return *this;
     }
 
     SharedPtr& operator=(SharedPtr&& other) {
-        SharedPtr<T>(std::move(other)).Swap(*this);
+        SharedPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
     template <typename Y>
-    SharedPtr& operator=(SharedPtr<Y>&& other) {
-        SharedPtr<T>(std::move(other)).Swap(*this);
+    SharedPtr& operator=(SharedPtr<Y, Counting>&& other) {
+        SharedPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -184,6 +415,13 @@ public:
 
     ~SharedPtr() {
         if (p_ctrl_block_) {
+            if constexpr (kIterativeDestruction<T>) {
+                if (!detail::ReleaseSink::Current()) {
+                    detail::ReleaseWorklist worklist;
+                    p_ctrl_block_->DecrSharedCount();
+                    return;
+                }
+            }
             p_ctrl_block_->DecrSharedCount();
         }
     }
@@ -197,7 +435,7 @@ public:
 
     template <typename Y>
     void Reset(Y* ptr) {
-        SharedPtr<T>(ptr).Swap(*this);
+        SharedPtr(ptr).Swap(*this);
     }
 
     void Swap(SharedPtr& other) noexcept {
@@ -228,29 +466,83 @@ public:
         return Get() == nullptr ? false : true;
     }
 
-    template <typename Y, typename... Args>
-    friend SharedPtr<Y> MakeShared(Args&&... args);
+    template <typename Y, typename C>
+    friend SharedPtr<Y, C> detail::AdoptShared(ControlBlockBase<C>* block, Y* ptr) noexcept;
 
-    template <typename Y>
+    template <typename Y, typename C>
     friend class SharedPtr;
 
+    template <typename Y, typename C>
+    friend class WeakPtr;
+
+    template <typename V>
+    friend class detail::AtomicSlot;
+
+    template <typename Y>
+    friend class ReadMostlyMainPtr;
+
 private:
-    ControlBlockBase* p_ctrl_block_ = nullptr;
+    ControlBlockBase<Counting>* p_ctrl_block_ = nullptr;
     T* raw_ptr_;
 };
 
-template <typename T, typename U>
-inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right) {
+template <typename T, typename U, typename Counting>
+inline bool operator==(const SharedPtr<T, Counting>& left, const SharedPtr<U, Counting>& right) {
     return left.Get() == right.Get();
 }
 
-// Allocate memory only once
-template <typename T, typename... Args>
-SharedPtr<T> MakeShared(Args&&... args) {
-    auto result = SharedPtr<T>();
-    result.p_ctrl_block_ = new ControlBlockMakeShared<T>;
-    result.raw_ptr_ =
-        new (&(dynamic_cast<ControlBlockMakeShared<T>*>(result.p_ctrl_block_)->holder_))
-            T(std::forward<Args>(args)...);
+namespace detail {
+
+template <typename T, typename Counting>
+SharedPtr<T, Counting> AdoptShared(ControlBlockBase<Counting>* block, T* ptr) noexcept {
+    auto result = SharedPtr<T, Counting>();
+    result.p_ctrl_block_ = block;
+    result.raw_ptr_ = ptr;
     return result;
-}
\ No newline at end of file
+}
+
+}  // namespace detail
+
+// Allocate memory only once
+// `MakeShared<T, LocalCounting>(...)` builds a `LocalSharedPtr<T>`,
+// `MakeShared<T, BiasedCounting>(...)` a `BiasedSharedPtr<T>`.
+// See `IsolateControlBlock` for the layout of the block.
+template <typename T, typename Counting = AtomicCounting, typename... Args>
+SharedPtr<T, Counting> MakeShared(Args&&... args) {
+    static_assert(!kHasMainReference<Counting>, "use MakeReadMostly");
+    auto* block = new ControlBlockMakeShared<T, Counting>;
+    return detail::AdoptShared<T, Counting>(block,
+                                            new (block->Object()) T(std::forward<Args>(args)...));
+}
+
+// Carves out the calling thread's slabs for `count` more blocks of `MakeShared<T, Counting>`
+template <typename T, typename Counting = AtomicCounting>
+void ReserveBlocks(size_t count) {
+    using Block = ControlBlockMakeShared<T, Counting>;
+    detail::SlabAllocator::Reserve(sizeof(Block), alignof(Block), count);
+}
+
+// Returns the pages of the calling thread's empty slabs to the OS, e.g. after a burst of
+// allocations; blocks still alive and other threads' slabs are left alone
+inline void TrimBlocks() noexcept {
+    detail::SlabAllocator::Trim();
+}
+
+// Lets every thread keep up to `per_thread` freed blocks of `MakeShared<T, Counting>` for reuse,
+// and all threads share up to `shared` more that they trade in batches; a `per_thread` of 0 (the
+// default) turns recycling off
+template <typename T, typename Counting = AtomicCounting>
+void SetRecycleCapacity(size_t per_thread, size_t shared) noexcept {
+    detail::BlockRecycler<ControlBlockMakeShared<T, Counting>>::SetCapacity(per_thread, shared);
+}
+
+// Shares up to eight threads' worth
+template <typename T, typename Counting = AtomicCounting>
+void SetRecycleCapacity(size_t per_thread) noexcept {
+    SetRecycleCapacity<T, Counting>(per_thread, 8 * per_thread);
+}
+
+template <typename T, typename Counting = AtomicCounting>
+RecycleStats GetRecycleStats() noexcept {
+    return detail::BlockRecycler<ControlBlockMakeShared<T, Counting>>::Stats();
+}
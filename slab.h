@@ -0,0 +1,430 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>  // std::uintptr_t
+#include <initializer_list>
+#include <mutex>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>  // madvise
+#endif
+
+namespace detail {
+
+// Size-class slab allocator for control blocks. Every thread carves blocks out of its own 64 KiB
+// slabs, one list of slabs per 16-byte size class, and frees its own blocks onto the slab's
+// local free list without synchronization. A block freed by another thread is pushed onto the
+// slab's lock-free remote list, which the owner takes over in one exchange when it runs out of
+// local blocks. Slabs found full wait on a list of their own until a local free puts them back in
+// service, or a recheck finds blocks freed remotely. Slabs of an exited thread are handed to the
+// next thread that needs one.
+//
+// Sizes above `kMaxSize` and alignments above `kGranule` go straight to the global allocator, as
+// does everything when SMART_PTRS_NO_SLAB is defined.
+class SlabAllocator {
+public:
+    static constexpr size_t kSlabSize = 64 * 1024;
+    static constexpr size_t kGranule = 16;
+    static constexpr size_t kMaxSize = 512;
+
+    static void* Allocate(size_t size, size_t align) {
+        if (!Eligible(size, align)) {
+            return GlobalNew(size, align);
+        }
+        if (Heap* heap = Heap::Current()) {
+            return heap->Allocate(ClassOf(size));
+        }
+        // The thread is past destroying its thread-locals
+        std::lock_guard lock(Fallback().mutex);
+        return Fallback().heap.Allocate(ClassOf(size));
+    }
+
+    static void Deallocate(void* storage, size_t size, size_t align) noexcept {
+        if (!Eligible(size, align)) {
+            GlobalDelete(storage, align);
+            return;
+        }
+        Slab* slab = SlabOf(storage);
+        Heap* heap = Heap::CurrentIfAny();
+        if (heap && slab->owner.load(std::memory_order_relaxed) == heap) {
+            heap->FreeLocal(slab, storage);
+        } else {
+            slab->FreeRemote(storage);
+        }
+    }
+
+    // Carves out slabs on the calling thread for `count` more blocks of `size` bytes aligned to
+    // `align` and faults their pages in
+    static void Reserve(size_t size, size_t align, size_t count) {
+        if (!Eligible(size, align) || !Heap::Current()) {
+            return;
+        }
+        Heap::Current()->Reserve(ClassOf(size), count);
+    }
+
+    // Returns the pages of the calling thread's empty slabs to the OS; all but the current slab
+    // of each size class are freed outright
+    static void Trim() noexcept {
+        if (Heap* heap = Heap::CurrentIfAny()) {
+            heap->Trim();
+        }
+    }
+
+private:
+    static constexpr size_t kClasses = kMaxSize / kGranule;
+    static constexpr size_t kPageSize = 4096;
+    // Full slabs are rechecked for remote frees once a new slab has been carved for every
+    // `kRecheckRatio` of them
+    static constexpr size_t kRecheckRatio = 8;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Heap;
+
+    // Header at the start of each slab; blocks follow it
+    struct Slab {
+        explicit Slab(size_t cls) : block_size((cls + 1) * kGranule) {
+            Reset();
+        }
+
+        char* Payload() noexcept {
+            return reinterpret_cast<char*>(this) + kHeaderSize;
+        }
+
+        void Reset() noexcept {
+            local = nullptr;
+            bump = Payload();
+        }
+
+        // Owner only
+        void* Take() noexcept {
+            void* result = nullptr;
+            if (local) {
+                result = local;
+                local = local->next;
+            } else if (bump + block_size <= reinterpret_cast<char*>(this) + kSlabSize) {
+                result = bump;
+                bump += block_size;
+            } else {
+                return nullptr;
+            }
+            ++live;
+            return result;
+        }
+        void FreeLocal(void* storage) noexcept {
+            auto* block = static_cast<FreeBlock*>(storage);
+            block->next = local;
+            local = block;
+            --live;
+        }
+        void CollectRemote() noexcept {
+            FreeBlock* block = remote.exchange(nullptr, std::memory_order_acquire);
+            while (block) {
+                FreeBlock* next = block->next;
+                FreeLocal(block);
+                block = next;
+            }
+        }
+
+        // Any thread
+        void FreeRemote(void* storage) noexcept {
+            auto* block = static_cast<FreeBlock*>(storage);
+            FreeBlock* head = remote.load(std::memory_order_relaxed);
+            do {
+                block->next = head;
+            } while (!remote.compare_exchange_weak(head, block, std::memory_order_release,
+                                                   std::memory_order_relaxed));
+        }
+
+        std::atomic<Heap*> owner = nullptr;
+        std::atomic<FreeBlock*> remote = nullptr;
+        FreeBlock* local;
+        char* bump;
+        const size_t block_size;
+        size_t live = 0;
+        Slab* next = nullptr;
+        // Links and flags the slabs on the owner's full list
+        Slab* prev = nullptr;
+        bool full = false;
+    };
+
+    static constexpr size_t kHeaderSize = (sizeof(Slab) + 63) / 64 * 64;
+
+    struct Heap {
+        Heap() = default;
+        Heap(const Heap&) = delete;
+        Heap& operator=(const Heap&) = delete;
+
+        // Slabs that still hold blocks go to the next thread that needs one
+        ~Heap() {
+            for (size_t cls = 0; cls < kClasses; ++cls) {
+                for (Slab* slab : {slabs[cls], full[cls]}) {
+                    while (slab) {
+                        Slab* next = slab->next;
+                        slab->CollectRemote();
+                        if (slab->live == 0) {
+                            FreeSlab(slab);
+                        } else {
+                            Abandon(cls, slab);
+                        }
+                        slab = next;
+                    }
+                }
+            }
+        }
+
+        static Heap* Current() {
+            thread_local bool exited = false;
+            struct Holder {
+                ~Holder() {
+                    exited = true;
+                    current = nullptr;
+                }
+                Heap heap;
+            };
+            if (exited) {
+                return nullptr;
+            }
+            thread_local Holder holder;
+            current = &holder.heap;
+            return current;
+        }
+        // Does not create a heap for the calling thread
+        static Heap* CurrentIfAny() noexcept {
+            return current;
+        }
+
+        void* Allocate(size_t cls) {
+            // Each slab found full leaves the list, so none is looked at twice
+            while (Slab* slab = slabs[cls]) {
+                if (void* result = slab->Take()) {
+                    return result;
+                }
+                slab->CollectRemote();
+                if (void* result = slab->Take()) {
+                    return result;
+                }
+                slabs[cls] = slab->next;
+                MarkFull(cls, slab);
+            }
+            // Rechecking the full slabs costs at most `kRecheckRatio` looks per new slab
+            if (full_count[cls] <= kRecheckRatio * carved[cls]) {
+                RecheckFull(cls);
+                if (slabs[cls]) {
+                    return slabs[cls]->Take();
+                }
+            }
+            // An abandoned slab may be full of blocks that outlived their thread; it joins this
+            // heap anyway and gets its blocks back through remote frees
+            while (Slab* slab = Adopt(cls)) {
+                if (void* result = slab->Take()) {
+                    slab->next = slabs[cls];
+                    slabs[cls] = slab;
+                    return result;
+                }
+                MarkFull(cls, slab);
+            }
+            Slab* slab = NewSlab(cls);
+            ++carved[cls];
+            slab->next = slabs[cls];
+            slabs[cls] = slab;
+            return slab->Take();
+        }
+
+        void FreeLocal(Slab* slab, void* storage) noexcept {
+            slab->FreeLocal(storage);
+            if (slab->full) {
+                Refilled(slab);
+            }
+        }
+
+        void Reserve(size_t cls, size_t count) {
+            const size_t per_slab = (kSlabSize - kHeaderSize) / ((cls + 1) * kGranule);
+            for (size_t i = 0; i < count; i += per_slab) {
+                Slab* slab = NewSlab(cls);
+                char* const end = reinterpret_cast<char*>(slab) + kSlabSize;
+                for (char* page = slab->Payload(); page < end; page += kPageSize) {
+                    *reinterpret_cast<volatile char*>(page) = 0;
+                }
+                // Behind the current slab, which keeps serving first
+                if (slabs[cls]) {
+                    slab->next = slabs[cls]->next;
+                    slabs[cls]->next = slab;
+                } else {
+                    slabs[cls] = slab;
+                }
+            }
+        }
+
+        void Trim() noexcept {
+            for (size_t cls = 0; cls < kClasses; ++cls) {
+                RecheckFull(cls);
+                for (Slab** link = &slabs[cls]; *link;) {
+                    Slab* slab = *link;
+                    slab->CollectRemote();
+                    if (slab->live != 0) {
+                        link = &slab->next;
+                    } else if (slab != slabs[cls]) {
+                        *link = slab->next;
+                        FreeSlab(slab);
+                    } else {
+                        ReleasePages(slab);
+                        link = &slab->next;
+                    }
+                }
+            }
+        }
+
+        void MarkFull(size_t cls, Slab* slab) noexcept {
+            slab->full = true;
+            slab->prev = nullptr;
+            slab->next = full[cls];
+            if (full[cls]) {
+                full[cls]->prev = slab;
+            }
+            full[cls] = slab;
+            ++full_count[cls];
+        }
+
+        // Moves a slab with free blocks from the full list to the front of the others
+        void Refilled(Slab* slab) noexcept {
+            const size_t cls = ClassOf(slab->block_size);
+            (slab->prev ? slab->prev->next : full[cls]) = slab->next;
+            if (slab->next) {
+                slab->next->prev = slab->prev;
+            }
+            --full_count[cls];
+            slab->full = false;
+            slab->next = slabs[cls];
+            slabs[cls] = slab;
+        }
+
+        // A full slab has no bump room left, so any block it gets back lands on its local list
+        void RecheckFull(size_t cls) noexcept {
+            carved[cls] = 0;
+            for (Slab* slab = full[cls]; slab;) {
+                Slab* next = slab->next;
+                slab->CollectRemote();
+                if (slab->local) {
+                    Refilled(slab);
+                }
+                slab = next;
+            }
+        }
+
+        Slab* NewSlab(size_t cls) {
+            void* memory = ::operator new(kSlabSize, std::align_val_t{kSlabSize});
+            auto* slab = new (memory) Slab(cls);
+            slab->owner.store(this, std::memory_order_relaxed);
+            return slab;
+        }
+
+        Slab* Adopt(size_t cls) {
+            Abandoned& abandoned = AbandonedSlabs();
+            Slab* slab;
+            {
+                std::lock_guard lock(abandoned.mutex);
+                slab = abandoned.slabs[cls];
+                if (!slab) {
+                    return nullptr;
+                }
+                abandoned.slabs[cls] = slab->next;
+            }
+            slab->next = nullptr;
+            slab->owner.store(this, std::memory_order_relaxed);
+            slab->CollectRemote();
+            return slab;
+        }
+
+        static inline thread_local Heap* current = nullptr;
+
+        Slab* slabs[kClasses] = {};
+        Slab* full[kClasses] = {};
+        size_t full_count[kClasses] = {};
+        // New slabs since the full list was last rechecked
+        size_t carved[kClasses] = {};
+    };
+
+    struct Abandoned {
+        std::mutex mutex;
+        Slab* slabs[kClasses] = {};
+    };
+
+    // Serves threads whose own heap is already gone
+    struct FallbackHeap {
+        std::mutex mutex;
+        Heap heap;
+    };
+
+    // Both live as long as the program: blocks may be freed during static destruction
+    static Abandoned& AbandonedSlabs() {
+        static auto* abandoned = new Abandoned;
+        return *abandoned;
+    }
+    static FallbackHeap& Fallback() {
+        static auto* fallback = new FallbackHeap;
+        return *fallback;
+    }
+
+    static void Abandon(size_t cls, Slab* slab) {
+        slab->owner.store(nullptr, std::memory_order_relaxed);
+        slab->full = false;
+        Abandoned& abandoned = AbandonedSlabs();
+        std::lock_guard lock(abandoned.mutex);
+        slab->next = abandoned.slabs[cls];
+        abandoned.slabs[cls] = slab;
+    }
+
+    static void FreeSlab(Slab* slab) noexcept {
+        slab->~Slab();
+        ::operator delete(slab, std::align_val_t{kSlabSize});
+    }
+
+    // Only called on an empty slab, which starts over from its first block
+    static void ReleasePages(Slab* slab) noexcept {
+#if defined(__unix__) || defined(__APPLE__)
+        const auto start = reinterpret_cast<std::uintptr_t>(slab->Payload());
+        const std::uintptr_t first_page = (start + kPageSize - 1) / kPageSize * kPageSize;
+        const std::uintptr_t end = reinterpret_cast<std::uintptr_t>(slab) + kSlabSize;
+        madvise(reinterpret_cast<void*>(first_page), end - first_page, MADV_DONTNEED);
+#endif
+        slab->Reset();
+    }
+
+    static bool Eligible(size_t size, size_t align) noexcept {
+#ifdef SMART_PTRS_NO_SLAB
+        return false;
+#else
+        return size <= kMaxSize && align <= kGranule;
+#endif
+    }
+
+    static size_t ClassOf(size_t size) noexcept {
+        return size ? (size - 1) / kGranule : 0;
+    }
+
+    static Slab* SlabOf(void* storage) noexcept {
+        const auto address = reinterpret_cast<std::uintptr_t>(storage);
+        return reinterpret_cast<Slab*>(address & ~(kSlabSize - 1));
+    }
+
+    static void* GlobalNew(size_t size, size_t align) {
+        if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return ::operator new(size, std::align_val_t{align});
+        }
+        return ::operator new(size);
+    }
+    static void GlobalDelete(void* storage, size_t align) noexcept {
+        if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(storage, std::align_val_t{align});
+        } else {
+            ::operator delete(storage);
+        }
+    }
+};
+
+}  // namespace detail
@@ -4,8 +4,37 @@
 
 class BadWeakPtr : public std::exception {};
 
-template <typename T>
+// Reference counting policies (see counting.h)
+class AtomicCounting;
+class LocalCounting;
+class BiasedCounting;
+class ShardedCounting;
+
+template <typename T, typename Counting = AtomicCounting>
 class SharedPtr;
 
+template <typename T, typename Counting = AtomicCounting>
+class WeakPtr;
+
+template <typename T>
+class ReadMostlyMainPtr;
+
+namespace detail {
+
+// Lock-free `SharedPtr`/`WeakPtr` slot (see atomic_shared.h)
+template <typename Value>
+class AtomicSlot;
+
+}  // namespace detail
+
+// Non-atomic counts for objects that never leave their thread
+template <typename T>
+using LocalSharedPtr = SharedPtr<T, LocalCounting>;
+
+// Non-atomic counts for the creating thread, atomic ones for everybody else
+template <typename T>
+using BiasedSharedPtr = SharedPtr<T, BiasedCounting>;
+
+// Copies of an object published through `ReadMostlyMainPtr`, counted on per-thread shards
 template <typename T>
-class WeakPtr;
\ No newline at end of file
+using ReadMostlySharedPtr = SharedPtr<T, ShardedCounting>;
@@ -0,0 +1,115 @@
+#include "affine.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> destroyed = 0;
+// Set when an object is destroyed away from its home thread
+std::atomic<bool> misplaced = false;
+
+struct Homed {
+    Homed() : home(std::this_thread::get_id()) {
+    }
+    ~Homed() {
+        if (std::this_thread::get_id() != home) {
+            misplaced = true;
+        }
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::thread::id home;
+};
+
+}  // namespace
+
+TEST_CASE("A release elsewhere waits for the home thread to poll") {
+    destroyed = 0;
+    misplaced = false;
+    auto local = MakeSharedAffine<Homed>();
+    local.Reset();
+    REQUIRE(destroyed == 1);
+
+    auto remote = MakeSharedAffine<Homed>();
+    std::thread([moved = std::move(remote)]() mutable { moved.Reset(); }).join();
+    REQUIRE(destroyed == 1);
+    REQUIRE(ThreadMailbox::Poll() == 1);
+    REQUIRE(destroyed == 2);
+    REQUIRE(!misplaced);
+}
+
+TEST_CASE("Posts are run when the home thread exits, or by the poster after that") {
+    destroyed = 0;
+    SharedPtr<Homed> posted;
+    SharedPtr<Homed> late;
+    std::atomic<int> step = 0;
+    std::thread home([&] {
+        posted = MakeSharedAffine<Homed>();
+        late = MakeSharedAffine<Homed>();
+        step = 1;
+        step.notify_one();
+        step.wait(1);
+    });
+    step.wait(0);
+    posted.Reset();
+    REQUIRE(destroyed == 0);
+    step = 2;
+    step.notify_one();
+    home.join();
+    REQUIRE(destroyed == 1);
+    // Nobody polls the mailbox anymore
+    late.Reset();
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("Releases from many threads all land on the home thread") {
+    constexpr int kThreads = 4;
+    constexpr int kObjects = 2000;
+    destroyed = 0;
+    misplaced = false;
+    std::vector<SharedPtr<Homed>> objects;
+    for (int i = 0; i < kObjects; ++i) {
+        objects.push_back(MakeSharedAffine<Homed>());
+    }
+    std::atomic<int> finished = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        std::vector<SharedPtr<Homed>> share;
+        for (int j = i; j < kObjects; j += kThreads) {
+            share.push_back(std::move(objects[j]));
+        }
+        threads.emplace_back([&finished, share = std::move(share)]() mutable {
+            share.clear();
+            finished.fetch_add(1, std::memory_order_release);
+        });
+    }
+    // Polls race with the posts
+    while (finished.load(std::memory_order_acquire) < kThreads) {
+        ThreadMailbox::Poll();
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    ThreadMailbox::Poll();
+    REQUIRE(destroyed == kObjects);
+    REQUIRE(!misplaced);
+}
+
+TEST_CASE("Blocks made after the mailbox is gone are destroyed in place") {
+    destroyed = 0;
+    struct Late {
+        ~Late() {
+            auto shared = MakeSharedAffine<Homed>();
+            ThreadMailbox::Poll();
+        }
+    };
+    std::thread([] {
+        // Made before the mailbox, so destroyed after it
+        thread_local Late late;
+        ThreadMailbox::Current();
+    }).join();
+    REQUIRE(destroyed == 1);
+}
@@ -0,0 +1,209 @@
+#include "atomic_shared.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> created = 0;
+std::atomic<int> destroyed = 0;
+
+struct Value {
+    explicit Value(int value) : value(value) {
+        created.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~Value() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    int value;
+};
+
+}  // namespace
+
+TEST_CASE("Loads follow stores and exchanges") {
+    AtomicSharedPtr<int> slot;
+    REQUIRE(slot.IsLockFree());
+    REQUIRE(!slot.Load());
+    slot.Store(MakeShared<int>(1));
+    REQUIRE(*slot.Load() == 1);
+    SharedPtr<int> old = slot.Exchange(MakeShared<int>(2));
+    REQUIRE(*old == 1);
+    REQUIRE(old.UseCount() == 1);
+    REQUIRE(*slot.Load() == 2);
+    slot.Store(SharedPtr<int>());
+    REQUIRE(!slot.Load());
+}
+
+TEST_CASE("Compare-exchange matches the stored block") {
+    auto first = MakeShared<int>(1);
+    AtomicSharedPtr<int> slot(first);
+    // Same value, different block
+    SharedPtr<int> expected = MakeShared<int>(1);
+    REQUIRE(!slot.CompareExchangeStrong(expected, MakeShared<int>(2)));
+    REQUIRE(expected == first);
+    REQUIRE(slot.CompareExchangeStrong(expected, MakeShared<int>(3)));
+    REQUIRE(*slot.Load() == 3);
+    // The slot let go of the replaced block
+    expected.Reset();
+    REQUIRE(first.UseCount() == 1);
+}
+
+TEST_CASE("Pins moved to a swapped-out node are dropped by late readers") {
+    constexpr int kReaders = 3;
+    constexpr int kStores = 5000;
+    created = 0;
+    destroyed = 0;
+    {
+        AtomicSharedPtr<Value> slot(MakeShared<Value>(0));
+        std::atomic<bool> stop = false;
+        // Catch assertions are not thread-safe
+        std::atomic<bool> ordered = true;
+        std::vector<std::thread> readers;
+        for (int i = 0; i < kReaders; ++i) {
+            readers.emplace_back([&] {
+                int last = 0;
+                while (!stop) {
+                    SharedPtr<Value> value = slot.Load();
+                    if (value->value < last) {
+                        ordered = false;
+                    }
+                    last = value->value;
+                }
+            });
+        }
+        // One thread bumps the value with compare-exchange while this one exchanges it
+        std::thread bumper([&] {
+            SharedPtr<Value> expected = slot.Load();
+            while (!stop) {
+                if (!slot.CompareExchangeWeak(expected, MakeShared<Value>(expected->value))) {
+                    continue;
+                }
+                expected = slot.Load();
+            }
+        });
+        for (int i = 1; i <= kStores; ++i) {
+            SharedPtr<Value> old = slot.Exchange(MakeShared<Value>(i));
+            if (old->value >= i) {
+                ordered = false;
+            }
+        }
+        stop = true;
+        bumper.join();
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(ordered);
+        REQUIRE(slot.Load()->value == kStores);
+    }
+    REQUIRE(created > kStores);
+    REQUIRE(destroyed == created);
+}
+
+TEST_CASE("Weak slots promote in place") {
+    AtomicWeakPtr<int> slot;
+    REQUIRE(!slot.LoadAndLock());
+    auto owner = MakeShared<int>(1);
+    slot.Store(owner);
+    REQUIRE(*slot.LoadAndLock() == 1);
+    REQUIRE(slot.Load().UseCount() == 1);
+
+    auto next = MakeShared<int>(2);
+    WeakPtr<int> old = slot.Exchange(next);
+    REQUIRE(*old.Lock() == 1);
+    REQUIRE(*slot.LoadAndLock() == 2);
+    next.Reset();
+    // The slot keeps the block, not the object
+    REQUIRE(slot.Load().Expired());
+    REQUIRE(!slot.LoadAndLock());
+}
+
+TEST_CASE("Weak slots re-pointed under readers") {
+    constexpr int kReaders = 3;
+    constexpr int kStores = 5000;
+    created = 0;
+    destroyed = 0;
+    {
+        auto first = MakeShared<Value>(0);
+        AtomicWeakPtr<Value> slot(first);
+        std::atomic<bool> stop = false;
+        // Catch assertions are not thread-safe
+        std::atomic<bool> ordered = true;
+        std::vector<std::thread> readers;
+        for (int i = 0; i < kReaders; ++i) {
+            readers.emplace_back([&] {
+                int last = 0;
+                while (!stop) {
+                    // Owners die right after being replaced, so the promotion may fail
+                    if (SharedPtr<Value> value = slot.LoadAndLock()) {
+                        if (value->value < last) {
+                            ordered = false;
+                        }
+                        last = value->value;
+                    }
+                }
+            });
+        }
+        SharedPtr<Value> owner = std::move(first);
+        for (int i = 1; i <= kStores; ++i) {
+            auto fresh = MakeShared<Value>(i);
+            slot.Store(fresh);
+            owner = std::move(fresh);
+        }
+        stop = true;
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(ordered);
+        REQUIRE(slot.LoadAndLock()->value == kStores);
+    }
+    REQUIRE(created == kStores + 1);
+    REQUIRE(destroyed == created);
+}
+
+TEST_CASE("Wait returns once the slot changes") {
+    AtomicSharedPtr<int> slot(MakeShared<int>(1));
+    SharedPtr<int> old = slot.Load();
+    // A different value is not waited on
+    slot.Wait(MakeShared<int>(1));
+    slot.Wait(SharedPtr<int>());
+
+    std::atomic<bool> woken = false;
+    std::thread waiter([&] {
+        slot.Wait(old);
+        woken = true;
+    });
+    // Storing an equal value in a new block counts as a change
+    slot.Store(MakeShared<int>(1));
+    slot.NotifyAll();
+    waiter.join();
+    REQUIRE(woken);
+    REQUIRE(slot.Load() != old);
+}
+
+TEST_CASE("Waiters hand a value back and forth") {
+    constexpr int kRounds = 2000;
+    AtomicSharedPtr<int> ping(MakeShared<int>(0));
+    AtomicSharedPtr<int> pong(MakeShared<int>(0));
+    // Read before the first ping can land
+    SharedPtr<int> seen = ping.Load();
+    std::thread partner([&] {
+        for (int i = 1; i <= kRounds; ++i) {
+            ping.Wait(seen);
+            seen = ping.Load();
+            pong.Store(seen);
+            pong.NotifyOne();
+        }
+    });
+    SharedPtr<int> reply = pong.Load();
+    for (int i = 1; i <= kRounds; ++i) {
+        ping.Store(MakeShared<int>(i));
+        ping.NotifyOne();
+        pong.Wait(reply);
+        reply = pong.Load();
+    }
+    partner.join();
+    REQUIRE(*reply == kRounds);
+}
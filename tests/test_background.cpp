@@ -0,0 +1,98 @@
+#include "background.h"
+#include "unique.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> destroyed = 0;
+std::atomic<bool> on_caller = false;
+
+struct Heavy {
+    explicit Heavy(std::thread::id owner) : owner(owner) {
+    }
+    ~Heavy() {
+        if (std::this_thread::get_id() == owner) {
+            on_caller = true;
+        }
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::thread::id owner;
+};
+
+// Destroyed after the default reclaimer would be if it were a plain static: it is built before
+// the first call to `Default()`
+struct ReleasedAtExit {
+    ~ReleasedAtExit() {
+        ptr.Reset();
+    }
+    SharedPtr<Heavy> ptr;
+} released_at_exit;
+
+}  // namespace
+
+TEST_CASE("Objects are destroyed on the reclaimer thread") {
+    destroyed = 0;
+    on_caller = false;
+    BackgroundReclaimer reclaimer;
+    for (int i = 0; i < 100; ++i) {
+        reclaimer.MakeShared<Heavy>(std::this_thread::get_id());
+    }
+    reclaimer.Drain();
+    REQUIRE(destroyed == 100);
+    REQUIRE(!on_caller);
+}
+
+TEST_CASE("UniquePtr deleter and backpressure") {
+    destroyed = 0;
+    BackgroundReclaimer reclaimer(4);
+    for (int i = 0; i < 100; ++i) {
+        UniquePtr<Heavy, BackgroundDelete<Heavy>> ptr(new Heavy(std::this_thread::get_id()),
+                                                      BackgroundDelete<Heavy>(reclaimer));
+    }
+    reclaimer.Drain();
+    REQUIRE(destroyed == 100);
+}
+
+TEST_CASE("Backpressure with several producers and tiny queues") {
+    constexpr int kProducers = 4;
+    constexpr int kPerProducer = 1000;
+    for (size_t capacity = 1; capacity <= 4; ++capacity) {
+        destroyed = 0;
+        BackgroundReclaimer reclaimer(capacity);
+        std::vector<std::thread> producers;
+        for (int i = 0; i < kProducers; ++i) {
+            producers.emplace_back([&] {
+                for (int j = 0; j < kPerProducer; ++j) {
+                    reclaimer.MakeShared<Heavy>(std::this_thread::get_id());
+                }
+            });
+        }
+        for (std::thread& producer : producers) {
+            producer.join();
+        }
+        reclaimer.Drain();
+        REQUIRE(destroyed == kProducers * kPerProducer);
+    }
+}
+
+TEST_CASE("Objects in flight are destroyed with the reclaimer") {
+    destroyed = 0;
+    {
+        BackgroundReclaimer reclaimer;
+        for (int i = 0; i < 100; ++i) {
+            reclaimer.MakeShared<Heavy>(std::this_thread::get_id());
+        }
+    }
+    REQUIRE(destroyed == 100);
+}
+
+TEST_CASE("The default reclaimer outlives static destruction") {
+    released_at_exit.ptr = MakeSharedBackground<Heavy>(std::this_thread::get_id());
+    BackgroundReclaimer::Default().Drain();
+    REQUIRE(released_at_exit.ptr);
+}
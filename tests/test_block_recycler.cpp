@@ -0,0 +1,78 @@
+#include "shared.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Recycler state is per type, so each case uses one of its own
+template <int N>
+struct Message {
+    int payload = N;
+};
+
+}  // namespace
+
+TEST_CASE("Freed blocks are reused by the same thread") {
+    using M = Message<1>;
+    SetRecycleCapacity<M>(4);
+    MakeShared<M>();
+    REQUIRE(GetRecycleStats<M>().misses == 1);
+    for (int i = 0; i < 10; ++i) {
+        auto ptr = MakeShared<M>();
+        REQUIRE(ptr->payload == 1);
+    }
+    REQUIRE(GetRecycleStats<M>().hits == 10);
+    REQUIRE(GetRecycleStats<M>().misses == 1);
+}
+
+TEST_CASE("Blocks freed by a consumer get back to the producer") {
+    using M = Message<2>;
+    constexpr size_t kPerThread = 16;
+    constexpr size_t kShared = 128;
+    SetRecycleCapacity<M>(kPerThread, kShared);
+    std::vector<SharedPtr<M>> batch;
+    for (int i = 0; i < 1000; ++i) {
+        batch.push_back(MakeShared<M>());
+    }
+    std::thread([&] { batch.clear(); }).join();
+    const RecycleStats before = GetRecycleStats<M>();
+    for (int i = 0; i < 1000; ++i) {
+        batch.push_back(MakeShared<M>());
+    }
+    // The consumer spilled into the shared list until it was full
+    REQUIRE(GetRecycleStats<M>().hits - before.hits == kShared);
+}
+
+TEST_CASE("Stats include threads that are still running") {
+    using M = Message<3>;
+    SetRecycleCapacity<M>(4);
+    std::atomic<int> step = 0;
+    std::thread thread([&] {
+        for (int i = 0; i < 5; ++i) {
+            MakeShared<M>();
+        }
+        step = 1;
+        step.notify_one();
+        step.wait(1);
+    });
+    step.wait(0);
+    REQUIRE(GetRecycleStats<M>().hits == 4);
+    REQUIRE(GetRecycleStats<M>().misses == 1);
+    step = 2;
+    step.notify_one();
+    thread.join();
+    REQUIRE(GetRecycleStats<M>().hits == 4);
+}
+
+TEST_CASE("Recycling is off by default") {
+    using M = Message<4>;
+    for (int i = 0; i < 3; ++i) {
+        MakeShared<M>();
+    }
+    REQUIRE(GetRecycleStats<M>().hits == 0);
+    REQUIRE(GetRecycleStats<M>().misses == 0);
+}
@@ -0,0 +1,90 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>  // std::uintptr_t
+#include <vector>
+
+namespace {
+
+int destroyed = 0;
+
+template <int N>
+struct Tracked {
+    ~Tracked() {
+        ++destroyed;
+    }
+    int value = N;
+};
+
+// Written while other threads copy pointers to it
+struct Hot {
+    int value = 0;
+};
+
+template <typename Counting>
+void CheckLifetime() {
+    destroyed = 0;
+    WeakPtr<Tracked<0>, Counting> weak;
+    {
+        auto shared = MakeShared<Tracked<0>, Counting>();
+        auto copy = shared;
+        weak = shared;
+        REQUIRE(copy.UseCount() == 2);
+    }
+    REQUIRE(destroyed == 1);
+    REQUIRE(weak.Expired());
+
+    SharedPtr<Tracked<0>, Counting> owned(new Tracked<0>);
+    owned.Reset();
+    REQUIRE(destroyed == 2);
+}
+
+}  // namespace
+
+template <>
+struct IsolateControlBlock<Hot> : std::true_type {};
+
+TEST_CASE("Blocks with tagged counts carry no manager pointer") {
+    static_assert(kKeepsTag<AtomicCounting> && kKeepsTag<LocalCounting>);
+    static_assert(sizeof(ControlBlockBase<AtomicCounting>) == sizeof(AtomicCounting));
+    static_assert(sizeof(ControlBlockBase<LocalCounting>) == sizeof(LocalCounting));
+    static_assert(sizeof(ControlBlockPtr<int, AtomicCounting>) == 3 * sizeof(void*));
+    static_assert(sizeof(ControlBlockMakeShared<int, AtomicCounting>) == 3 * sizeof(void*));
+
+    static_assert(!kKeepsTag<PackedCounting<>>);
+    static_assert(sizeof(ControlBlockBase<PackedCounting<>>) ==
+                  sizeof(PackedCounting<>) + sizeof(void*));
+}
+
+TEST_CASE("Each block type finds its own manager") {
+    destroyed = 0;
+    {
+        auto a = MakeShared<Tracked<1>>();
+        auto b = MakeShared<Tracked<2>>();
+        SharedPtr<Tracked<3>> c(new Tracked<3>);
+        REQUIRE(a->value + b->value + c->value == 6);
+    }
+    REQUIRE(destroyed == 3);
+}
+
+TEST_CASE("Objects and blocks are released under every counting policy") {
+    CheckLifetime<AtomicCounting>();
+    CheckLifetime<LocalCounting>();
+    CheckLifetime<PackedCounting<>>();
+    CheckLifetime<StickyCounting>();
+}
+
+TEST_CASE("Isolated objects start on their own cache line") {
+    using Block = ControlBlockMakeShared<Hot, AtomicCounting>;
+    static_assert(alignof(Block) == kCacheLineSize);
+    static_assert(sizeof(Block) == 2 * kCacheLineSize);
+    static_assert(sizeof(ControlBlockMakeShared<Tracked<0>, AtomicCounting>) < kCacheLineSize);
+
+    std::vector<SharedPtr<Hot>> pointers;
+    for (int i = 0; i < 100; ++i) {
+        pointers.push_back(MakeShared<Hot>());
+        REQUIRE(reinterpret_cast<std::uintptr_t>(pointers.back().Get()) % kCacheLineSize == 0);
+    }
+}
@@ -0,0 +1,332 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Counted {
+    explicit Counted(std::atomic<int>& destroyed) : destroyed(destroyed) {
+    }
+    ~Counted() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::atomic<int>& destroyed;
+};
+
+}  // namespace
+
+TEST_CASE("LocalSharedPtr counts on one thread") {
+    std::atomic<int> destroyed = 0;
+    {
+        LocalSharedPtr<Counted> first = MakeShared<Counted, LocalCounting>(destroyed);
+        REQUIRE(first.UseCount() == 1);
+        {
+            LocalSharedPtr<Counted> second = first;
+            REQUIRE(first.UseCount() == 2);
+        }
+        REQUIRE(first.UseCount() == 1);
+        REQUIRE(destroyed == 0);
+    }
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("SharedPtr copies race across threads") {
+    constexpr int kThreads = 4;
+    constexpr int kCopies = 20000;
+    std::atomic<int> destroyed = 0;
+    {
+        auto shared = MakeShared<Counted>(destroyed);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; ++i) {
+            threads.emplace_back([shared] {
+                for (int j = 0; j < kCopies; ++j) {
+                    SharedPtr<Counted> copy = shared;
+                    SharedPtr<Counted> moved = std::move(copy);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(shared.UseCount() == 1);
+        REQUIRE(destroyed == 0);
+    }
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Last owner on another thread destroys the object") {
+    std::atomic<int> destroyed = 0;
+    auto shared = SharedPtr<Counted>(new Counted(destroyed));
+    std::thread([owned = std::move(shared)]() mutable { owned.Reset(); }).join();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Biased counts release on the owner thread") {
+    std::atomic<int> destroyed = 0;
+    {
+        BiasedSharedPtr<Counted> first = MakeShared<Counted, BiasedCounting>(destroyed);
+        BiasedSharedPtr<Counted> second = first;
+        REQUIRE(first.UseCount() == 2);
+    }
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("A biased reference dropped elsewhere is merged by the owner") {
+    std::atomic<int> destroyed = 0;
+    BiasedSharedPtr<Counted> kept = MakeShared<Counted, BiasedCounting>(destroyed);
+    BiasedSharedPtr<Counted> given = kept;
+    // Drives the atomic count below zero and queues the block to this thread
+    std::thread([given = std::move(given)]() mutable { given.Reset(); }).join();
+    REQUIRE(destroyed == 0);
+    kept.Reset();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("The last biased reference outlives its owner thread") {
+    std::atomic<int> destroyed = 0;
+    BiasedSharedPtr<Counted> kept;
+    std::thread([&] {
+        kept = MakeShared<Counted, BiasedCounting>(destroyed);
+        BiasedSharedPtr<Counted> extra = kept;
+    }).join();
+    REQUIRE(destroyed == 0);
+    // The owner is gone, so the release merges here
+    kept.Reset();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Biased blocks handed to other threads are destroyed once") {
+    constexpr int kObjects = 2000;
+    constexpr int kConsumers = 3;
+    std::atomic<int> destroyed = 0;
+    std::mutex mutex;
+    std::vector<BiasedSharedPtr<Counted>> handed;
+    std::atomic<bool> done = false;
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < kConsumers; ++i) {
+        consumers.emplace_back([&] {
+            while (true) {
+                BiasedSharedPtr<Counted> ptr;
+                {
+                    std::lock_guard lock(mutex);
+                    if (!handed.empty()) {
+                        ptr = std::move(handed.back());
+                        handed.pop_back();
+                    } else if (done) {
+                        return;
+                    }
+                }
+                BiasedSharedPtr<Counted> copy = ptr;
+                ptr.Reset();
+            }
+        });
+    }
+    std::thread owner([&] {
+        for (int i = 0; i < kObjects; ++i) {
+            BiasedSharedPtr<Counted> ptr = MakeShared<Counted, BiasedCounting>(destroyed);
+            std::lock_guard lock(mutex);
+            handed.push_back(ptr);
+        }
+        done = true;
+    });
+    owner.join();
+    for (std::thread& consumer : consumers) {
+        consumer.join();
+    }
+    REQUIRE(destroyed == kObjects);
+}
+
+namespace {
+
+// Makes and drops biased pointers from a thread-local destructor
+struct LateBiased {
+    ~LateBiased() {
+        BiasedSharedPtr<Counted> ptr = MakeShared<Counted, BiasedCounting>(*destroyed);
+        BiasedSharedPtr<Counted> copy = ptr;
+    }
+    std::atomic<int>* destroyed;
+};
+
+}  // namespace
+
+TEST_CASE("Biased references released after their owner's thread-locals") {
+    std::atomic<int> destroyed = 0;
+    std::thread([&] {
+        // Constructed after the block's owner, so destroyed before it
+        thread_local BiasedSharedPtr<Counted> late;
+        late = MakeShared<Counted, BiasedCounting>(destroyed);
+    }).join();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Biased blocks made after the thread-locals are gone") {
+    std::atomic<int> destroyed = 0;
+    std::thread([&] {
+        // Constructed before the thread's owner, so destroyed after it
+        thread_local LateBiased late{&destroyed};
+        MakeShared<Counted, BiasedCounting>(destroyed);
+    }).join();
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("Packed counts share one word") {
+    static_assert(sizeof(PackedCounting<>) == sizeof(uint64_t));
+    std::atomic<int> destroyed = 0;
+    // A narrow shared field leaves the rest of the word to weak references
+    using Small = PackedCounting<8>;
+    WeakPtr<Counted, Small> weak;
+    {
+        SharedPtr<Counted, Small> shared = MakeShared<Counted, Small>(destroyed);
+        std::vector<SharedPtr<Counted, Small>> copies(200, shared);
+        std::vector<WeakPtr<Counted, Small>> weaks(1000, shared);
+        weak = shared;
+        REQUIRE(shared.UseCount() == 201);
+        REQUIRE(weak.UseCount() == 201);
+    }
+    REQUIRE(destroyed == 1);
+    REQUIRE(weak.Expired());
+}
+
+TEST_CASE("Packed counts race with weak promotions") {
+    constexpr int kThreads = 4;
+    constexpr int kRounds = 500;
+    using Packed = PackedCounting<>;
+    std::atomic<int> destroyed = 0;
+    // Catch assertions are not thread-safe
+    std::atomic<bool> valid = true;
+    for (int round = 0; round < kRounds; ++round) {
+        SharedPtr<Counted, Packed> shared = MakeShared<Counted, Packed>(destroyed);
+        WeakPtr<Counted, Packed> weak = shared;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; ++i) {
+            threads.emplace_back([&, copy = shared]() mutable {
+                for (int j = 0; j < 20; ++j) {
+                    SharedPtr<Counted, Packed> locked = weak.TryLock();
+                    if (!locked) {
+                        valid = false;
+                    }
+                }
+                copy.Reset();
+            });
+        }
+        shared.Reset();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        if (!weak.Expired()) {
+            valid = false;
+        }
+    }
+    REQUIRE(valid);
+    REQUIRE(destroyed == kRounds);
+}
+
+TEST_CASE("A sticky zero is released exactly once") {
+    constexpr int kThreads = 4;
+    constexpr int kRounds = 500;
+    std::atomic<int> destroyed = 0;
+    // Catch assertions are not thread-safe
+    std::atomic<bool> valid = true;
+    for (int round = 0; round < kRounds; ++round) {
+        SharedPtr<Counted, StickyCounting> shared = MakeShared<Counted, StickyCounting>(destroyed);
+        WeakPtr<Counted, StickyCounting> weak = shared;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; ++i) {
+            // Promotions and count reads race with the last release
+            threads.emplace_back([&] {
+                for (int j = 0; j < 20; ++j) {
+                    SharedPtr<Counted, StickyCounting> locked = weak.TryLock();
+                    // A promoted pointer keeps the object alive and counts itself
+                    if (locked && (locked->destroyed < 0 || locked.UseCount() == 0)) {
+                        valid = false;
+                    }
+                    // Reading a transient zero helps it stick
+                    weak.UseCount();
+                }
+            });
+        }
+        shared.Reset();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        if (!weak.Expired() || weak.TryLock()) {
+            valid = false;
+        }
+    }
+    REQUIRE(valid);
+    REQUIRE(destroyed == kRounds);
+}
+
+namespace {
+
+struct DeferredNode {
+    explicit DeferredNode(std::atomic<int>& destroyed) : counted(destroyed) {
+    }
+    Counted counted;
+    SharedPtr<DeferredNode, DeferredCounting> next;
+};
+
+}  // namespace
+
+TEST_CASE("Deferred releases wait for the end of the scope") {
+    std::atomic<int> destroyed = 0;
+    auto outside = MakeShared<Counted, DeferredCounting>(destroyed);
+    outside.Reset();
+    REQUIRE(destroyed == 1);
+    {
+        DeferredCountingScope scope;
+        auto ptr = MakeShared<Counted, DeferredCounting>(destroyed);
+        {
+            DeferredCountingScope nested;
+            ptr.Reset();
+        }
+        // Only the outermost scope flushes
+        REQUIRE(destroyed == 1);
+    }
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("A copy cancels a pending release") {
+    std::atomic<int> destroyed = 0;
+    DeferredCountingScope scope;
+    auto ptr = MakeShared<Counted, DeferredCounting>(destroyed);
+    for (int i = 0; i < 100; ++i) {
+        SharedPtr<Counted, DeferredCounting> copy = ptr;
+    }
+    // One release stays logged instead of a hundred
+    REQUIRE(ptr.UseCount() == 2);
+    DeferredCountingScope::Flush();
+    REQUIRE(ptr.UseCount() == 1);
+    ptr.Reset();
+    DeferredCountingScope::Flush();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Flushes survive evictions and releases from destructors") {
+    constexpr int kNodes = 500;
+    std::atomic<int> destroyed = 0;
+    {
+        DeferredCountingScope scope;
+        // More blocks than log slots, and every node's destructor releases the next one
+        SharedPtr<DeferredNode, DeferredCounting> head;
+        for (int i = 0; i < kNodes; ++i) {
+            auto node = MakeShared<DeferredNode, DeferredCounting>(destroyed);
+            node->next = std::move(head);
+            head = std::move(node);
+        }
+        std::vector<SharedPtr<Counted, DeferredCounting>> loose;
+        for (int i = 0; i < kNodes; ++i) {
+            loose.push_back(MakeShared<Counted, DeferredCounting>(destroyed));
+        }
+        head.Reset();
+        loose.clear();
+    }
+    REQUIRE(destroyed == 2 * kNodes);
+}
@@ -0,0 +1,81 @@
+#include "destruction_scope.h"
+#include "shared.h"
+#include "unique.h"
+#include "weak.h"
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+namespace {
+
+std::vector<int> order;
+
+template <int N>
+struct Tracked {
+    ~Tracked() {
+        order.push_back(N);
+    }
+};
+
+// Releases its child from its own destructor
+struct Parent {
+    ~Parent() {
+        order.push_back(0);
+    }
+    SharedPtr<Tracked<1>> child = MakeShared<Tracked<1>>();
+};
+
+}  // namespace
+
+TEST_CASE("Releases run when the scope ends") {
+    order.clear();
+    WeakPtr<Tracked<1>> weak;
+    {
+        DestructionScope scope;
+        auto shared = MakeShared<Tracked<1>>();
+        weak = shared;
+        shared.Reset();
+        UniquePtr<Tracked<2>> unique(new Tracked<2>);
+        unique.Reset();
+        REQUIRE(order.empty());
+        REQUIRE(weak.Expired());
+        // The block is released later as well
+        weak.Reset();
+    }
+    REQUIRE(order.size() == 2);
+}
+
+TEST_CASE("Releases of one type run back to back") {
+    order.clear();
+    {
+        DestructionScope scope;
+        for (int i = 0; i < 10; ++i) {
+            MakeShared<Tracked<1>>();
+            MakeShared<Tracked<2>>();
+            UniquePtr<Tracked<3>>(new Tracked<3>);
+        }
+    }
+    REQUIRE(order.size() == 30);
+    int switches = 0;
+    for (size_t i = 1; i < order.size(); ++i) {
+        switches += order[i] != order[i - 1];
+    }
+    REQUIRE(switches == 2);
+}
+
+TEST_CASE("Releases triggered by a flush are collected too") {
+    order.clear();
+    {
+        DestructionScope outer;
+        MakeShared<Parent>();
+        {
+            DestructionScope inner;
+            MakeShared<Tracked<2>>();
+        }
+        // The inner scope ran only its own release
+        REQUIRE(order == std::vector<int>{2});
+        outer.Flush();
+        REQUIRE(order == std::vector<int>{2, 0, 1});
+    }
+}
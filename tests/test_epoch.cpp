@@ -0,0 +1,149 @@
+#include "epoch.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> destroyed = 0;
+
+struct Value {
+    explicit Value(int value) : value(value) {
+    }
+    ~Value() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    int value;
+};
+
+std::atomic<int> late_seen = 0;
+
+// Reads the slot from its destructor, which runs after the domain's thread-locals are gone
+struct LateReader {
+    ~LateReader() {
+        EpochGuard guard(*domain);
+        late_seen = slot->Get(guard)->value + slot->Load()->value;
+    }
+    EpochDomain* domain;
+    EpochSharedPtr<Value>* slot;
+};
+
+}  // namespace
+
+TEST_CASE("Readers see the published value") {
+    EpochDomain domain;
+    EpochSharedPtr<Value> slot(MakeShared<Value>(1), domain);
+    {
+        EpochGuard guard(domain);
+        REQUIRE(slot.Get(guard)->value == 1);
+    }
+    slot.Store(MakeShared<Value>(2));
+    REQUIRE(slot.Load()->value == 2);
+    auto old = slot.Exchange(MakeShared<Value>(3));
+    REQUIRE(old->value == 2);
+}
+
+TEST_CASE("Synchronize reclaims what was retired before it") {
+    EpochDomain domain;
+    destroyed = 0;
+    {
+        EpochSharedPtr<Value> slot(MakeShared<Value>(1), domain);
+        slot.Store(MakeShared<Value>(2));
+        domain.Synchronize();
+        REQUIRE(destroyed == 1);
+    }
+    domain.Synchronize();
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("A rare writer does not pin old values") {
+    EpochDomain domain;
+    destroyed = 0;
+    EpochSharedPtr<Value> slot(MakeShared<Value>(0), domain);
+    // With no reader around every retirement moves the epoch, so each value is reclaimed two
+    // stores after it was replaced
+    for (int i = 1; i <= 5; ++i) {
+        slot.Store(MakeShared<Value>(i));
+    }
+    REQUIRE(destroyed >= 3);
+    domain.Reclaim();
+    domain.Reclaim();
+    REQUIRE(destroyed == 5);
+}
+
+TEST_CASE("A reader inside a section holds back reclamation") {
+    EpochDomain domain;
+    destroyed = 0;
+    EpochSharedPtr<Value> slot(MakeShared<Value>(1), domain);
+    std::atomic<bool> inside = false;
+    std::atomic<bool> release = false;
+    std::thread reader([&] {
+        EpochGuard guard(domain);
+        Value* value = slot.Get(guard);
+        inside = true;
+        while (!release) {
+            std::this_thread::yield();
+        }
+        REQUIRE(value->value == 1);
+    });
+    while (!inside) {
+        std::this_thread::yield();
+    }
+    slot.Store(MakeShared<Value>(2));
+    for (int i = 0; i < 10; ++i) {
+        domain.TryAdvance();
+    }
+    REQUIRE(destroyed == 0);
+    release = true;
+    reader.join();
+    domain.Synchronize();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Readers work from thread-local destructors") {
+    EpochDomain domain;
+    EpochSharedPtr<Value> slot(MakeShared<Value>(7), domain);
+    late_seen = 0;
+    std::thread([&] {
+        // Constructed before the domain's thread-locals, so destroyed after them
+        thread_local LateReader reader{&domain, &slot};
+        EpochGuard guard(domain);
+    }).join();
+    REQUIRE(late_seen == 14);
+    domain.Synchronize();
+}
+
+TEST_CASE("Concurrent readers and writers") {
+    EpochDomain domain;
+    destroyed = 0;
+    {
+        EpochSharedPtr<Value> slot(MakeShared<Value>(0), domain);
+        std::atomic<bool> stop = false;
+        // Catch assertions are not thread-safe
+        std::atomic<bool> valid = true;
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 3; ++i) {
+            readers.emplace_back([&] {
+                while (!stop) {
+                    EpochGuard guard(domain);
+                    if (slot.Get(guard)->value < 0) {
+                        valid = false;
+                    }
+                }
+            });
+        }
+        for (int i = 1; i <= 2000; ++i) {
+            slot.Store(MakeShared<Value>(i));
+        }
+        stop = true;
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(valid);
+    }
+    domain.Synchronize();
+    REQUIRE(destroyed == 2001);
+}
@@ -0,0 +1,130 @@
+#include "hazard.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> destroyed = 0;
+
+struct Value {
+    explicit Value(int value) : value(value) {
+    }
+    ~Value() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    int value;
+};
+
+}  // namespace
+
+TEST_CASE("Readers see the stored value") {
+    HazardDomain domain;
+    HazardSharedPtr<Value> slot(MakeShared<Value>(1), domain);
+    {
+        HazardPointer hazard(domain);
+        REQUIRE(slot.Protect(hazard)->value == 1);
+    }
+    slot.Store(MakeShared<Value>(2));
+    REQUIRE(slot.Load()->value == 2);
+}
+
+TEST_CASE("A protected value outlives its replacement") {
+    HazardDomain domain;
+    destroyed = 0;
+    HazardSharedPtr<Value> slot(MakeShared<Value>(1), domain);
+    HazardPointer hazard(domain);
+    Value* value = slot.Protect(hazard);
+    slot.Store(MakeShared<Value>(2));
+    domain.Scan();
+    REQUIRE(destroyed == 0);
+    REQUIRE(value->value == 1);
+    hazard.Reset();
+    domain.Scan();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Exchange and Reset retire the old value") {
+    HazardDomain domain;
+    destroyed = 0;
+    HazardSharedPtr<Value> slot(MakeShared<Value>(1), domain);
+    HazardPointer hazard(domain);
+    Value* protected_value = slot.Protect(hazard);
+    SharedPtr<Value> old = slot.Exchange(MakeShared<Value>(2));
+    REQUIRE(old->value == 1);
+    REQUIRE(slot.Load()->value == 2);
+    // The caller's reference and the protected node both keep the old value
+    old.Reset();
+    domain.Scan();
+    REQUIRE(destroyed == 0);
+    REQUIRE(protected_value->value == 1);
+    hazard.Reset();
+    domain.Scan();
+    REQUIRE(destroyed == 1);
+
+    slot.Reset();
+    REQUIRE(!slot.Load());
+    domain.Scan();
+    REQUIRE(destroyed == 2);
+    REQUIRE(!slot.Exchange(MakeShared<Value>(3)));
+}
+
+TEST_CASE("Scan bounds what a rare writer pins") {
+    HazardDomain domain;
+    destroyed = 0;
+    HazardSharedPtr<Value> slot(MakeShared<Value>(0), domain);
+    for (int i = 1; i <= 3; ++i) {
+        slot.Store(MakeShared<Value>(i));
+    }
+    // Below the batch size nothing was scanned yet
+    REQUIRE(destroyed == 0);
+    domain.Scan();
+    REQUIRE(destroyed == 3);
+}
+
+TEST_CASE("Large retirements trigger a scan") {
+    HazardDomain domain(1000);
+    destroyed = 0;
+    HazardSharedPtr<Value> slot(MakeShared<Value>(0), domain);
+    slot.Store(MakeShared<Value>(1), 600);
+    slot.Store(MakeShared<Value>(2), 600);
+    REQUIRE(destroyed == 0);
+    // Replacing the second large value brings the retired bytes past the limit
+    slot.Store(MakeShared<Value>(3));
+    REQUIRE(destroyed == 3);
+}
+
+TEST_CASE("Concurrent readers and writers") {
+    HazardDomain domain;
+    destroyed = 0;
+    {
+        HazardSharedPtr<Value> slot(MakeShared<Value>(0), domain);
+        std::atomic<bool> stop = false;
+        // Catch assertions are not thread-safe
+        std::atomic<bool> valid = true;
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 3; ++i) {
+            readers.emplace_back([&] {
+                HazardPointer hazard(domain);
+                while (!stop) {
+                    if (slot.Protect(hazard)->value < 0 || slot.Load()->value < 0) {
+                        valid = false;
+                    }
+                }
+            });
+        }
+        for (int i = 1; i <= 2000; ++i) {
+            slot.Store(MakeShared<Value>(i));
+        }
+        stop = true;
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(valid);
+    }
+    domain.Scan();
+    REQUIRE(destroyed == 2001);
+}
@@ -0,0 +1,72 @@
+#include "incremental.h"
+#include "shared.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <vector>
+
+namespace {
+
+int destroyed = 0;
+
+struct Node {
+    ~Node() {
+        ++destroyed;
+    }
+    std::vector<SharedPtr<Node>> children;
+};
+
+// A complete tree with `fanout` children per inner node
+SharedPtr<Node> MakeTree(int depth, int fanout) {
+    auto node = MakeShared<Node>();
+    if (depth > 0) {
+        for (int i = 0; i < fanout; ++i) {
+            node->children.push_back(MakeTree(depth - 1, fanout));
+        }
+    }
+    return node;
+}
+
+}  // namespace
+
+TEST_CASE("Steps destroy a bounded number of objects") {
+    destroyed = 0;
+    IncrementalReclaimer reclaimer;
+    // 1 + 4 + 16 + 64 nodes
+    SharedPtr<Node> root = MakeTree(3, 4);
+    root.Reset();
+    REQUIRE(destroyed == 0);
+    REQUIRE(reclaimer.Pending() == 1);
+    REQUIRE(reclaimer.Step(10));
+    // Freeing a block is a release of its own
+    REQUIRE(destroyed > 0);
+    REQUIRE(destroyed <= 10);
+    while (reclaimer.Step(10)) {
+    }
+    REQUIRE(destroyed == 85);
+    REQUIRE(reclaimer.Pending() == 0);
+}
+
+TEST_CASE("Steps stop at the time budget") {
+    destroyed = 0;
+    IncrementalReclaimer reclaimer;
+    MakeTree(3, 4);
+    REQUIRE(reclaimer.Step(std::chrono::nanoseconds(0)));
+    REQUIRE(destroyed == 0);
+    REQUIRE(!reclaimer.Step(std::chrono::seconds(10)));
+    REQUIRE(destroyed == 85);
+}
+
+TEST_CASE("The reclaimer finishes its work when destroyed") {
+    destroyed = 0;
+    {
+        IncrementalReclaimer reclaimer;
+        MakeTree(3, 4);
+        reclaimer.Step(5);
+    }
+    REQUIRE(destroyed == 85);
+    // Uninstalled again
+    MakeTree(1, 4);
+    REQUIRE(destroyed == 90);
+}
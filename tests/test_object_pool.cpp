@@ -0,0 +1,107 @@
+#include "object_pool.h"
+
+#include <catch2/catch.hpp>
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int constructed = 0;
+
+struct Buffer {
+    Buffer() {
+        ++constructed;
+    }
+    void Reset() {
+        size = 0;
+    }
+    int size = 0;
+};
+
+}  // namespace
+
+TEST_CASE("Released objects are reset and reused") {
+    constructed = 0;
+    ObjectPool<Buffer> pool;
+    Buffer* first;
+    {
+        auto buffer = pool.AcquireShared();
+        buffer->size = 10;
+        first = buffer.Get();
+    }
+    auto again = pool.AcquireUnique();
+    REQUIRE(again.Get() == first);
+    REQUIRE(again->size == 0);
+    REQUIRE(constructed == 1);
+}
+
+TEST_CASE("A default deleter allows an empty UniquePtr") {
+    constructed = 0;
+    ObjectPool<Buffer> pool;
+    UniquePtr<Buffer, PoolDeleter<Buffer>> buffer;
+    REQUIRE(!buffer);
+    buffer = pool.AcquireUnique();
+    REQUIRE(buffer);
+    Buffer* first = buffer.Get();
+    buffer.Reset();
+    REQUIRE(pool.AcquireUnique().Get() == first);
+    REQUIRE(constructed == 1);
+    // Deleting through a deleter of no pool does nothing
+    PoolDeleter<Buffer>()(nullptr);
+}
+
+TEST_CASE("Objects freed on another thread come back through the overflow list") {
+    constructed = 0;
+    ObjectPool<Buffer> pool(2);
+    std::vector<UniquePtr<Buffer, PoolDeleter<Buffer>>> buffers;
+    for (int i = 0; i < 8; ++i) {
+        buffers.push_back(pool.AcquireUnique());
+    }
+    std::thread([&] { buffers.clear(); }).join();
+    for (int i = 0; i < 8; ++i) {
+        buffers.push_back(pool.AcquireUnique());
+    }
+    REQUIRE(constructed == 8);
+}
+
+namespace {
+
+// Default `PoolReset` leaves the child in place, so freeing a node recycles its child
+struct Node {
+    UniquePtr<Node, PoolDeleter<Node>> child;
+};
+
+}  // namespace
+
+TEST_CASE("Pooled objects may own pooled objects") {
+    // Outlives the nodes of `pool` that own its nodes
+    ObjectPool<Node> children(4, 1);
+    ObjectPool<Node> pool(4, 1);
+    SECTION("of the same pool") {
+        std::vector<UniquePtr<Node, PoolDeleter<Node>>> nodes;
+        for (int i = 0; i < 32; ++i) {
+            nodes.push_back(pool.AcquireUnique());
+            nodes.back()->child = pool.AcquireUnique();
+        }
+        nodes.clear();
+        for (int i = 0; i < 32; ++i) {
+            nodes.push_back(pool.AcquireUnique());
+        }
+    }
+    SECTION("of a pool this thread has not used yet") {
+        {
+            std::vector<UniquePtr<Node, PoolDeleter<Node>>> nodes;
+            std::thread([&] {
+                for (int i = 0; i < 32; ++i) {
+                    nodes.push_back(pool.AcquireUnique());
+                    nodes.back()->child = children.AcquireUnique();
+                }
+            }).join();
+        }
+        for (int i = 0; i < 32; ++i) {
+            REQUIRE(pool.AcquireUnique());
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#include "parallel.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <cstdlib>  // std::malloc, std::free
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Allocations this thread may still make before `operator new` throws; negative means unlimited
+thread_local int allocations_left = -1;
+
+std::atomic<int> destroyed = 0;
+
+struct Node {
+    ~Node() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::vector<SharedPtr<Node>> children;
+};
+
+// Complete binary tree of 2^(depth + 1) - 1 nodes
+SharedPtr<Node> BuildTree(int depth) {
+    auto node = MakeShared<Node>();
+    if (depth > 0) {
+        node->children.push_back(BuildTree(depth - 1));
+        node->children.push_back(BuildTree(depth - 1));
+    }
+    return node;
+}
+
+struct UniqueNode {
+    ~UniqueNode() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    UniquePtr<UniqueNode> left;
+    UniquePtr<UniqueNode> right;
+};
+
+UniquePtr<UniqueNode> BuildUniqueTree(int depth) {
+    UniquePtr<UniqueNode> node(new UniqueNode);
+    if (depth > 0) {
+        node->left = BuildUniqueTree(depth - 1);
+        node->right = BuildUniqueTree(depth - 1);
+    }
+    return node;
+}
+
+}  // namespace
+
+// Kept out of line so that GCC doesn't pair the inlined malloc with a sized delete and warn
+[[gnu::noinline]] void* operator new(size_t size) {
+    if (allocations_left == 0) {
+        throw std::bad_alloc();
+    }
+    if (allocations_left > 0) {
+        --allocations_left;
+    }
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return std::malloc(size ? size : 1);
+}
+[[gnu::noinline]] void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+[[gnu::noinline]] void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+[[gnu::noinline]] void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+TEST_CASE("Teardown destroys a whole tree before returning") {
+    ParallelReclaimer pool(4);
+    for (int round = 0; round < 20; ++round) {
+        destroyed = 0;
+        pool.Teardown(BuildTree(10));
+        REQUIRE(destroyed == (1 << 11) - 1);
+    }
+}
+
+TEST_CASE("Nodes shared within the graph are destroyed once") {
+    ParallelReclaimer pool(4);
+    destroyed = 0;
+    auto shared = BuildTree(8);
+    auto root = MakeShared<Node>();
+    for (int i = 0; i < 64; ++i) {
+        auto child = MakeShared<Node>();
+        child->children.push_back(shared);
+        root->children.push_back(child);
+    }
+    shared.Reset();
+    pool.Teardown(std::move(root));
+    REQUIRE(destroyed == 1 + 64 + (1 << 9) - 1);
+}
+
+TEST_CASE("Teardown of UniquePtr trees") {
+    ParallelReclaimer pool(3);
+    destroyed = 0;
+    pool.Teardown(BuildUniqueTree(10));
+    REQUIRE(destroyed == (1 << 11) - 1);
+}
+
+TEST_CASE("Concurrent teardowns share the pool") {
+    ParallelReclaimer pool(4);
+    destroyed = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&pool] {
+            for (int round = 0; round < 10; ++round) {
+                pool.Teardown(BuildTree(8));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    pool.Wait();
+    REQUIRE(destroyed == 4 * 10 * ((1 << 9) - 1));
+}
+
+TEST_CASE("An idle pool waits and shuts down") {
+    ParallelReclaimer pool(2);
+    pool.Wait();
+    pool.Teardown(SharedPtr<Node>());
+    REQUIRE(pool.Threads() == 2);
+}
+
+TEST_CASE("A pool that fails to start joins the workers it started") {
+    // Fail each allocation of the constructor in turn, including the ones that start threads
+    bool started = false;
+    int failures = 0;
+    for (int budget = 0; !started; ++budget) {
+        allocations_left = budget;
+        try {
+            ParallelReclaimer pool(4);
+            allocations_left = -1;
+            started = true;
+        } catch (const std::bad_alloc&) {
+            allocations_left = -1;
+            ++failures;
+        }
+    }
+    REQUIRE(failures > 4);
+}
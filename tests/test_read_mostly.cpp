@@ -0,0 +1,97 @@
+#include "read_mostly.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> destroyed = 0;
+
+struct Value {
+    explicit Value(int value) : value(value) {
+    }
+    ~Value() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    int value;
+};
+
+struct Throwing {
+    Throwing() {
+        throw std::runtime_error("not built");
+    }
+    ~Throwing() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+}  // namespace
+
+TEST_CASE("Copies outlive the main pointer") {
+    destroyed = 0;
+    ReadMostlyMainPtr<Value> main = MakeReadMostly<Value>(3);
+    ReadMostlySharedPtr<Value> first = main.GetShared();
+    ReadMostlySharedPtr<Value> second = first;
+    REQUIRE(second->value == 3);
+    REQUIRE(first.UseCount() == 3);
+    main.Reset();
+    // Folded into the central count
+    REQUIRE(first.UseCount() == 2);
+    first.Reset();
+    REQUIRE(destroyed == 0);
+    second.Reset();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("A copy taken on one thread is dropped on another") {
+    destroyed = 0;
+    ReadMostlyMainPtr<Value> main = MakeReadMostly<Value>(1);
+    ReadMostlySharedPtr<Value> copy = main.GetShared();
+    // That thread's shard goes negative until the shards are folded
+    std::thread([moved = std::move(copy)]() mutable { moved.Reset(); }).join();
+    REQUIRE(main.GetShared().UseCount() == 2);
+    main.Reset();
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Copies race with releasing the main pointer") {
+    constexpr int kThreads = 4;
+    constexpr int kRounds = 200;
+    destroyed = 0;
+    // Catch assertions are not thread-safe
+    std::atomic<bool> valid = true;
+    for (int round = 0; round < kRounds; ++round) {
+        ReadMostlyMainPtr<Value> main = MakeReadMostly<Value>(round);
+        ReadMostlySharedPtr<Value> seed = main.GetShared();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; ++i) {
+            threads.emplace_back([&, copy = seed]() mutable {
+                for (int j = 0; j < 100; ++j) {
+                    ReadMostlySharedPtr<Value> next = copy;
+                    if (next->value != round) {
+                        valid = false;
+                    }
+                    copy = std::move(next);
+                }
+            });
+        }
+        seed.Reset();
+        main.Reset();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    REQUIRE(valid);
+    REQUIRE(destroyed == kRounds);
+}
+
+TEST_CASE("A throwing constructor leaves nothing behind") {
+    destroyed = 0;
+    REQUIRE_THROWS_AS(MakeReadMostly<Throwing>(), std::runtime_error);
+    // The half-built object is not destroyed, and the block is freed (ASan checks that)
+    REQUIRE(destroyed == 0);
+}
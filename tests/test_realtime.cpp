@@ -0,0 +1,99 @@
+#define SMART_PTRS_TRAP_REALTIME_ALLOCATIONS
+#include "realtime.h"
+#include "unique.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+std::atomic<int> destroyed = 0;
+std::atomic<int> trapped = 0;
+
+template <int N>
+struct Sample {
+    ~Sample() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    int value = N;
+};
+
+void CountTrap() {
+    trapped.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+TEST_CASE("Real-time threads neither allocate nor free") {
+    SetRealtimeAllocationTrap(&CountTrap);
+    ReserveRealtime<Sample<1>>(16);
+    RealtimeReleaseQueue queue;
+    UniquePtr<Sample<2>> unique(new Sample<2>);
+    destroyed = 0;
+    trapped = 0;
+    std::thread([&] {
+        RealtimeScope scope(queue);
+        for (int i = 0; i < 16; ++i) {
+            SharedPtr<Sample<1>> shared = MakeShared<Sample<1>>();
+        }
+        unique.Reset();
+    }).join();
+    REQUIRE(trapped == 0);
+    REQUIRE(destroyed == 0);
+    // Blocks are freed by the draining thread along with their objects
+    REQUIRE(queue.Drain() == 17);
+    REQUIRE(destroyed == 17);
+    REQUIRE(queue.Overflows() == 0);
+    SetRealtimeAllocationTrap(&std::abort);
+}
+
+TEST_CASE("The trap fires once the reserve runs out") {
+    SetRealtimeAllocationTrap(&CountTrap);
+    ReserveRealtime<Sample<3>>(2);
+    RealtimeReleaseQueue queue;
+    trapped = 0;
+    std::thread([&] {
+        RealtimeScope scope(queue);
+        SharedPtr<Sample<3>> first = MakeShared<Sample<3>>();
+        SharedPtr<Sample<3>> second = MakeShared<Sample<3>>();
+        SharedPtr<Sample<3>> third = MakeShared<Sample<3>>();
+    }).join();
+    REQUIRE(trapped > 0);
+    queue.Drain();
+    SetRealtimeAllocationTrap(&std::abort);
+}
+
+TEST_CASE("Releases that find the queue full run in place") {
+    ReserveRealtime<Sample<4>>(4);
+    RealtimeReleaseQueue queue(2);
+    destroyed = 0;
+    {
+        RealtimeScope scope(queue);
+        for (int i = 0; i < 4; ++i) {
+            MakeShared<Sample<4>>();
+        }
+    }
+    // Two objects ran in place, and so did freeing their blocks
+    REQUIRE(queue.Overflows() == 4);
+    REQUIRE(destroyed == 2);
+    queue.Drain();
+    REQUIRE(destroyed == 4);
+}
+
+TEST_CASE("A queue of capacity 1 neither overwrites nor loses items") {
+    detail::BoundedQueue<int> queue(1);
+    REQUIRE(queue.TryPush(1));
+    REQUIRE(queue.TryPush(2));
+    REQUIRE(!queue.TryPush(3));
+    int value = 0;
+    REQUIRE(queue.TryPop(value));
+    REQUIRE(value == 1);
+    REQUIRE(queue.TryPop(value));
+    REQUIRE(value == 2);
+    REQUIRE(!queue.TryPop(value));
+    REQUIRE(queue.TryPush(4));
+    REQUIRE(queue.TryPop(value));
+    REQUIRE(value == 4);
+}
@@ -0,0 +1,132 @@
+#include "shared.h"
+#include "unique.h"
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+int destroyed = 0;
+
+struct SharedNode;
+struct UniqueNode;
+struct CountedNode;
+
+}  // namespace
+
+template <>
+struct IterativeDestruction<SharedNode> : std::true_type {};
+template <>
+struct IterativeDestruction<UniqueNode> : std::true_type {};
+template <>
+struct IterativeDestruction<CountedNode> : std::true_type {};
+
+namespace {
+
+struct SharedNode {
+    ~SharedNode() {
+        ++destroyed;
+    }
+    SharedPtr<SharedNode> next;
+};
+
+struct UniqueNode {
+    ~UniqueNode() {
+        ++destroyed;
+    }
+    UniquePtr<UniqueNode> next;
+};
+
+// A deleter with state of its own
+struct CountingDelete {
+    void operator()(CountedNode* node) const;
+
+    int* deleted;
+};
+
+struct CountedNode {
+    ~CountedNode() {
+        ++destroyed;
+    }
+    UniquePtr<CountedNode, CountingDelete> next{nullptr, CountingDelete{nullptr}};
+};
+
+void CountingDelete::operator()(CountedNode* node) const {
+    delete node;
+    ++*deleted;
+}
+
+// Deep enough to overflow the stack if each node recursed into the next
+constexpr int kNodes = 1'000'000;
+
+}  // namespace
+
+TEST_CASE("Long SharedPtr chains are destroyed in a loop") {
+    destroyed = 0;
+    SharedPtr<SharedNode> head;
+    for (int i = 0; i < kNodes; ++i) {
+        auto node = MakeShared<SharedNode>();
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    // A chain shared halfway down stops there
+    SharedPtr<SharedNode> middle = head;
+    for (int i = 0; i < kNodes / 2; ++i) {
+        middle = middle->next;
+    }
+    head.Reset();
+    REQUIRE(destroyed == kNodes / 2);
+    middle.Reset();
+    REQUIRE(destroyed == kNodes);
+}
+
+TEST_CASE("Long UniquePtr chains are destroyed in a loop") {
+    destroyed = 0;
+    UniquePtr<UniqueNode> head;
+    for (int i = 0; i < kNodes; ++i) {
+        UniquePtr<UniqueNode> node(new UniqueNode);
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    head.Reset();
+    REQUIRE(destroyed == kNodes);
+}
+
+TEST_CASE("Long UniquePtr chains with stateful deleters are destroyed in a loop") {
+    destroyed = 0;
+    int deleted = 0;
+    UniquePtr<CountedNode, CountingDelete> head(nullptr, CountingDelete{&deleted});
+    for (int i = 0; i < kNodes; ++i) {
+        UniquePtr<CountedNode, CountingDelete> node(new CountedNode, CountingDelete{&deleted});
+        node->next = std::move(head);
+        head = std::move(node);
+    }
+    head.Reset();
+    REQUIRE(destroyed == kNodes);
+    REQUIRE(deleted == kNodes);
+}
+
+// The chain length the feature promises; takes a few GB and seconds, so run it on request with
+// `test_release_sink [deep]`
+TEST_CASE("Chains of 10^8 nodes are destroyed in a loop", "[.][deep]") {
+    constexpr int kDeepNodes = 100'000'000;
+    destroyed = 0;
+    {
+        UniquePtr<UniqueNode> head;
+        for (int i = 0; i < kDeepNodes; ++i) {
+            UniquePtr<UniqueNode> node(new UniqueNode);
+            node->next = std::move(head);
+            head = std::move(node);
+        }
+    }
+    REQUIRE(destroyed == kDeepNodes);
+    destroyed = 0;
+    {
+        SharedPtr<SharedNode> head;
+        for (int i = 0; i < kDeepNodes; ++i) {
+            auto node = MakeShared<SharedNode>();
+            node->next = std::move(head);
+            head = std::move(node);
+        }
+    }
+    REQUIRE(destroyed == kDeepNodes);
+}
@@ -0,0 +1,173 @@
+#include "shared.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using detail::SlabAllocator;
+
+namespace {
+
+constexpr size_t kAlign = 16;
+// Enough blocks to fill several slabs
+constexpr size_t kBlocks = 3 * SlabAllocator::kSlabSize / 32;
+
+void* SlabOf(void* block) {
+    const auto address = reinterpret_cast<std::uintptr_t>(block);
+    return reinterpret_cast<void*>(address & ~(SlabAllocator::kSlabSize - 1));
+}
+
+std::vector<void*> SlabsOf(const std::vector<void*>& blocks) {
+    std::vector<void*> slabs;
+    for (void* block : blocks) {
+        slabs.push_back(SlabOf(block));
+    }
+    std::sort(slabs.begin(), slabs.end());
+    slabs.erase(std::unique(slabs.begin(), slabs.end()), slabs.end());
+    return slabs;
+}
+
+}  // namespace
+
+TEST_CASE("Blocks of a thread are reused after a local free") {
+    constexpr size_t kSize = 32;
+    void* first = SlabAllocator::Allocate(kSize, kAlign);
+    SlabAllocator::Deallocate(first, kSize, kAlign);
+    void* second = SlabAllocator::Allocate(kSize, kAlign);
+    REQUIRE(second == first);
+    SlabAllocator::Deallocate(second, kSize, kAlign);
+}
+
+// Each case below uses a size class of its own, so it starts from fresh slabs
+
+TEST_CASE("Remote frees return blocks to the owning thread") {
+    constexpr size_t kSize = 48;
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < kBlocks; ++i) {
+        blocks.push_back(SlabAllocator::Allocate(kSize, kAlign));
+    }
+    std::thread([&] {
+        for (void* block : blocks) {
+            SlabAllocator::Deallocate(block, kSize, kAlign);
+        }
+    }).join();
+    const std::vector<void*> slabs = SlabsOf(blocks);
+    std::vector<void*> again;
+    for (size_t i = 0; i < kBlocks; ++i) {
+        again.push_back(SlabAllocator::Allocate(kSize, kAlign));
+        REQUIRE(std::binary_search(slabs.begin(), slabs.end(), SlabOf(again.back())));
+    }
+    for (void* block : again) {
+        SlabAllocator::Deallocate(block, kSize, kAlign);
+    }
+}
+
+TEST_CASE("A local free puts a full slab back in service") {
+    constexpr size_t kSize = 112;
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < kBlocks; ++i) {
+        blocks.push_back(SlabAllocator::Allocate(kSize, kAlign));
+    }
+    // The first slab filled up long ago
+    void* freed = blocks.front();
+    SlabAllocator::Deallocate(freed, kSize, kAlign);
+    blocks.front() = SlabAllocator::Allocate(kSize, kAlign);
+    REQUIRE(blocks.front() == freed);
+    for (void* block : blocks) {
+        SlabAllocator::Deallocate(block, kSize, kAlign);
+    }
+}
+
+TEST_CASE("Concurrent remote frees are not lost") {
+    constexpr size_t kSize = 64;
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < kBlocks; ++i) {
+        blocks.push_back(SlabAllocator::Allocate(kSize, kAlign));
+    }
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&blocks, t] {
+            for (size_t i = t; i < blocks.size(); i += 4) {
+                SlabAllocator::Deallocate(blocks[i], kSize, kAlign);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const std::vector<void*> slabs = SlabsOf(blocks);
+    std::vector<void*> again;
+    for (size_t i = 0; i < kBlocks; ++i) {
+        again.push_back(SlabAllocator::Allocate(kSize, kAlign));
+        REQUIRE(std::binary_search(slabs.begin(), slabs.end(), SlabOf(again.back())));
+    }
+    // No block is handed out twice
+    std::sort(again.begin(), again.end());
+    REQUIRE(std::adjacent_find(again.begin(), again.end()) == again.end());
+    for (void* block : again) {
+        SlabAllocator::Deallocate(block, kSize, kAlign);
+    }
+}
+
+TEST_CASE("Slabs of an exited thread are adopted") {
+    constexpr size_t kSize = 80;
+    std::vector<void*> kept;
+    std::thread([&] {
+        std::vector<void*> blocks;
+        for (size_t i = 0; i < kBlocks; ++i) {
+            blocks.push_back(SlabAllocator::Allocate(kSize, kAlign));
+        }
+        // Every other block stays alive past the thread
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            if (i % 2) {
+                kept.push_back(blocks[i]);
+            } else {
+                SlabAllocator::Deallocate(blocks[i], kSize, kAlign);
+            }
+        }
+    }).join();
+    const std::vector<void*> slabs = SlabsOf(kept);
+    std::thread([&] {
+        void* block = SlabAllocator::Allocate(kSize, kAlign);
+        REQUIRE(std::binary_search(slabs.begin(), slabs.end(), SlabOf(block)));
+        SlabAllocator::Deallocate(block, kSize, kAlign);
+        for (void* kept_block : kept) {
+            SlabAllocator::Deallocate(kept_block, kSize, kAlign);
+        }
+    }).join();
+}
+
+TEST_CASE("Full slabs of an exited thread do not break allocation") {
+    std::vector<SharedPtr<int>> kept;
+    std::thread([&] {
+        for (size_t i = 0; i < kBlocks; ++i) {
+            kept.push_back(MakeShared<int>(static_cast<int>(i)));
+        }
+    }).join();
+    std::thread([] {
+        auto shared = MakeShared<int>(42);
+        REQUIRE(*shared == 42);
+    }).join();
+    // The full slabs are owned by an exited thread again; freeing into them is remote
+    kept.clear();
+    auto shared = MakeShared<int>(7);
+    REQUIRE(*shared == 7);
+}
+
+TEST_CASE("Trim keeps the heap usable") {
+    constexpr size_t kSize = 96;
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < kBlocks; ++i) {
+        blocks.push_back(SlabAllocator::Allocate(kSize, kAlign));
+    }
+    for (void* block : blocks) {
+        SlabAllocator::Deallocate(block, kSize, kAlign);
+    }
+    TrimBlocks();
+    void* block = SlabAllocator::Allocate(kSize, kAlign);
+    REQUIRE(block != nullptr);
+    SlabAllocator::Deallocate(block, kSize, kAlign);
+}
@@ -0,0 +1,127 @@
+#include "thread_cached.h"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<int> destroyed = 0;
+
+struct Value {
+    explicit Value(int value) : value(value) {
+    }
+    ~Value() {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+    int value;
+};
+
+}  // namespace
+
+TEST_CASE("Reads follow stores") {
+    ThreadCachedSharedPtr<Value> cached(MakeShared<Value>(1));
+    REQUIRE(cached.Get()->value == 1);
+    cached.Store(MakeShared<Value>(2));
+    REQUIRE(cached.Get()->value == 2);
+    REQUIRE(cached.Load()->value == 2);
+}
+
+TEST_CASE("A snapshot lasts until the thread reads again") {
+    ThreadCachedSharedPtr<Value> cached(MakeShared<Value>(1));
+    const SharedPtr<Value>& snapshot = cached.Get();
+    // That read dropped what earlier cases left behind
+    destroyed = 0;
+    cached.Store(MakeShared<Value>(2));
+    REQUIRE(destroyed == 0);
+    REQUIRE(snapshot->value == 1);
+    REQUIRE(cached.Get()->value == 2);
+    REQUIRE(destroyed == 1);
+}
+
+TEST_CASE("Snapshots of a destroyed instance go on the next read") {
+    destroyed = 0;
+    ThreadCachedSharedPtr<Value> other(MakeShared<Value>(0));
+    auto cached = std::make_unique<ThreadCachedSharedPtr<Value>>(MakeShared<Value>(1));
+    std::atomic<int> step = 0;
+    std::thread reader([&] {
+        REQUIRE(cached->Get()->value == 1);
+        step = 1;
+        step.wait(1);
+        REQUIRE(other.Get()->value == 0);
+        step = 3;
+        step.notify_one();
+        // Exiting would drop the snapshot anyway
+        step.wait(3);
+    });
+    step.wait(0);
+    cached.reset();
+    // The reader's snapshot still holds the object
+    REQUIRE(destroyed == 0);
+    step = 2;
+    step.notify_one();
+    step.wait(2);
+    REQUIRE(destroyed == 1);
+    step = 4;
+    step.notify_one();
+    reader.join();
+}
+
+TEST_CASE("Reads of an unchanged instance leave other snapshots alone") {
+    ThreadCachedSharedPtr<Value> other(MakeShared<Value>(0));
+    REQUIRE(other.Get()->value == 0);
+    auto cached = std::make_unique<ThreadCachedSharedPtr<Value>>(MakeShared<Value>(1));
+    REQUIRE(cached->Get()->value == 1);
+    destroyed = 0;
+    cached.reset();
+    // The fast path never looks for destroyed instances
+    REQUIRE(other.Get()->value == 0);
+    REQUIRE(destroyed == 0);
+    // A new snapshot does
+    other.Store(MakeShared<Value>(2));
+    REQUIRE(other.Get()->value == 2);
+    REQUIRE(destroyed == 2);
+}
+
+TEST_CASE("A reused id does not serve the old snapshot") {
+    auto first = std::make_unique<ThreadCachedSharedPtr<Value>>(MakeShared<Value>(1));
+    REQUIRE(first->Get()->value == 1);
+    first.reset();
+    ThreadCachedSharedPtr<Value> second(MakeShared<Value>(2));
+    REQUIRE(second.Get()->value == 2);
+}
+
+TEST_CASE("Concurrent readers and a writer") {
+    destroyed = 0;
+    {
+        ThreadCachedSharedPtr<Value> cached(MakeShared<Value>(0));
+        std::atomic<bool> stop = false;
+        // Catch assertions are not thread-safe
+        std::atomic<bool> ordered = true;
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 3; ++i) {
+            readers.emplace_back([&] {
+                int last = 0;
+                while (!stop) {
+                    const int value = cached.Get()->value;
+                    if (value < last) {
+                        ordered = false;
+                    }
+                    last = value;
+                }
+            });
+        }
+        for (int i = 1; i <= 1000; ++i) {
+            cached.Store(MakeShared<Value>(i));
+        }
+        stop = true;
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        REQUIRE(ordered);
+    }
+    REQUIRE(destroyed == 1001);
+}
@@ -0,0 +1,20 @@
+#include "unique.h"
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("Arrays are indexed through the pointer") {
+    UniquePtr<int[]> array(new int[3]{1, 2, 3});
+    REQUIRE(array[1] == 2);
+    array[2] = 5;
+    REQUIRE(array.Get()[2] == 5);
+    const UniquePtr<int[]>& view = array;
+    REQUIRE(view[0] == 1);
+}
+
+TEST_CASE("Arrays swap their pointers") {
+    UniquePtr<int[]> first(new int[2]{1, 2});
+    UniquePtr<int[]> second(new int[1]{3});
+    first.Swap(second);
+    REQUIRE(first[0] == 3);
+    REQUIRE(second[1] == 2);
+}
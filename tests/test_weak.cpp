@@ -0,0 +1,54 @@
+#include "weak.h"
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+int destroyed = 0;
+
+struct Node {
+    ~Node() {
+        ++destroyed;
+    }
+    SharedPtr<Node> child;
+    WeakPtr<Node> parent;
+};
+
+}  // namespace
+
+TEST_CASE("Lock promotes a live pointer") {
+    auto shared = MakeShared<int>(5);
+    WeakPtr<int> weak = shared;
+    REQUIRE(!weak.Expired());
+    REQUIRE(weak.UseCount() == 1);
+    SharedPtr<int> locked = weak.Lock();
+    REQUIRE(*locked == 5);
+    REQUIRE(shared.UseCount() == 2);
+    REQUIRE(*weak.TryLock() == 5);
+}
+
+TEST_CASE("An expired pointer throws from Lock and is empty from TryLock") {
+    WeakPtr<int> weak;
+    REQUIRE(weak.Expired());
+    REQUIRE_THROWS_AS(weak.Lock(), BadWeakPtr);
+    REQUIRE(!weak.TryLock());
+
+    auto shared = MakeShared<int>(1);
+    weak = shared;
+    shared.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE_THROWS_AS(SharedPtr<int>(weak), BadWeakPtr);
+    REQUIRE(!weak.TryLock());
+}
+
+TEST_CASE("Weak back references break cycles") {
+    destroyed = 0;
+    {
+        auto parent = MakeShared<Node>();
+        parent->child = MakeShared<Node>();
+        parent->child->parent = parent;
+        REQUIRE(parent.UseCount() == 1);
+        REQUIRE(parent->child->parent.Lock() == parent);
+    }
+    REQUIRE(destroyed == 2);
+}
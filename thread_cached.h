@@ -0,0 +1,169 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+#include "atomic_shared.h"
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Hot global `SharedPtr` that changes rarely. Every thread keeps its own snapshot of the value and
+// the version it was taken at, and takes a new reference only after a `Store()`; in the common
+// case a read is one relaxed load and a compare, with no count traffic at all.
+//
+// A thread's snapshot keeps the old object alive until the thread reads again or exits. Once an
+// instance is destroyed, every thread drops its snapshot of it the next time it takes a new
+// snapshot of any instance of the same type.
+template <typename T, typename Counting = AtomicCounting>
+class ThreadCachedSharedPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ThreadCachedSharedPtr() : ThreadCachedSharedPtr(SharedPtr<T, Counting>()) {
+    }
+    explicit ThreadCachedSharedPtr(SharedPtr<T, Counting> value)
+        : generation_(NextVersion()), id_(AcquireId(generation_)), current_(std::move(value)),
+          version_(NextVersion()) {
+    }
+
+    ThreadCachedSharedPtr(const ThreadCachedSharedPtr&) = delete;
+    ThreadCachedSharedPtr& operator=(const ThreadCachedSharedPtr&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~ThreadCachedSharedPtr() {
+        ReleaseId(id_);
+        destructions_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Readers pick the new value up on their next `Get()`
+    void Store(SharedPtr<T, Counting> desired) {
+        current_.Store(std::move(desired));
+        version_.store(NextVersion(), std::memory_order_release);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // The calling thread's snapshot; the reference stays valid until this thread calls `Get()`
+    // on the same object again
+    const SharedPtr<T, Counting>& Get() const {
+        Entry& entry = ThreadEntry();
+        const uint64_t version = version_.load(std::memory_order_relaxed);
+        if (entry.version != version) {
+            // Pairs with the release in `Store()`, so the load below sees at least that value
+            std::atomic_thread_fence(std::memory_order_acquire);
+            DropStaleIfDestroyed();
+            current_.Load().Swap(entry.snapshot);
+            entry.version = version;
+            entry.generation = generation_;
+        }
+        return entry.snapshot;
+    }
+
+    // A reference of the caller's own
+    SharedPtr<T, Counting> Load() const {
+        return Get();
+    }
+
+private:
+    struct Entry {
+        uint64_t version = 0;
+        // Of the instance the snapshot was taken from
+        uint64_t generation = 0;
+        SharedPtr<T, Counting> snapshot;
+    };
+
+    // A deque keeps references to existing entries valid while it grows
+    struct Cache {
+        std::deque<Entry> entries;
+        uint64_t destructions = 0;
+    };
+
+    // Versions are unique across all instances, so an entry left behind by a destroyed instance
+    // never matches the one that reuses its id
+    static uint64_t NextVersion() noexcept {
+        static std::atomic<uint64_t> next_version = 1;
+        return next_version.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Dense ids index each thread's entries directly; `owners_` holds the generation of the
+    // instance that has each id, or 0 while it is free
+    static size_t AcquireId(uint64_t generation) {
+        std::lock_guard lock(ids_mutex_);
+        size_t id;
+        if (free_ids_.empty()) {
+            id = owners_.size();
+            owners_.push_back(generation);
+        } else {
+            id = free_ids_.back();
+            free_ids_.pop_back();
+            owners_[id] = generation;
+        }
+        return id;
+    }
+    static void ReleaseId(size_t id) {
+        std::lock_guard lock(ids_mutex_);
+        free_ids_.push_back(id);
+        owners_[id] = 0;
+    }
+
+    static Cache& ThreadCache() {
+        thread_local Cache cache;
+        return cache;
+    }
+
+    Entry& ThreadEntry() const {
+        Cache& cache = ThreadCache();
+        if (id_ >= cache.entries.size()) {
+            cache.entries.resize(id_ + 1);
+        }
+        return cache.entries[id_];
+    }
+
+    // Off the read fast path: only a thread about to take a new snapshot checks for destroyed
+    // instances. Never moves entries, so the caller's one stays valid.
+    static void DropStaleIfDestroyed() {
+        Cache& cache = ThreadCache();
+        const uint64_t destructions = destructions_.load(std::memory_order_relaxed);
+        if (cache.destructions != destructions) {
+            cache.destructions = destructions;
+            DropStale(cache);
+        }
+    }
+
+    // Drops the snapshots of destroyed instances; `owners_` is read under the lock, so a relaxed
+    // count is enough to notice them. `stale` outlives the lock: releasing an object may destroy
+    // another instance.
+    static void DropStale(Cache& cache) {
+        std::vector<SharedPtr<T, Counting>> stale;
+        std::lock_guard lock(ids_mutex_);
+        for (size_t id = 0; id < cache.entries.size(); ++id) {
+            Entry& entry = cache.entries[id];
+            if (entry.snapshot && owners_[id] != entry.generation) {
+                stale.push_back(std::move(entry.snapshot));
+                entry.version = 0;
+            }
+        }
+    }
+
+    static inline std::mutex ids_mutex_;
+    static inline std::vector<size_t> free_ids_;
+    static inline std::vector<uint64_t> owners_;
+    static inline std::atomic<uint64_t> destructions_ = 0;
+
+    const uint64_t generation_;
+    const size_t id_;
+    AtomicSharedPtr<T, Counting> current_;
+    std::atomic<uint64_t> version_;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>  // size_t
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace detail {
+
+// The calling thread's `T`, one per type; null once the thread is past destroying its
+// thread-locals, when a fresh one would never be destroyed
+template <typename T>
+T* ThreadLocal() noexcept(std::is_nothrow_default_constructible_v<T>) {
+    thread_local bool exited = false;
+    struct Holder {
+        ~Holder() {
+            exited = true;
+        }
+        T value;
+    };
+    if (exited) {
+        return nullptr;
+    }
+    thread_local Holder holder;
+    return &holder.value;
+}
+
+// What each thread keeps per owner (a domain, say); `State` has an `owner` member, and its
+// destructor hands whatever it holds back to the owner, both when the thread exits and when the
+// owner forgets it
+template <typename State>
+class ThreadStates {
+public:
+    // The calling thread's state for `owner`, made by `make()` on first use; null once the thread
+    // is past destroying its thread-locals
+    template <typename Owner, typename Make>
+    static State* Find(const Owner* owner, Make&& make) {
+        std::vector<State>* states = ThreadLocal<std::vector<State>>();
+        if (!states) {
+            return nullptr;
+        }
+        for (State& state : *states) {
+            if (state.owner == owner) {
+                return &state;
+            }
+        }
+        return &states->emplace_back(std::forward<Make>(make)());
+    }
+
+    // Destroys the calling thread's state for `owner`, if any, and tells whether there was one.
+    // The state is off the list before its destructor runs, so that may find states again.
+    template <typename Owner>
+    static bool Forget(const Owner* owner) noexcept {
+        std::vector<State>* states = ThreadLocal<std::vector<State>>();
+        if (!states) {
+            return false;
+        }
+        auto it = std::find_if(states->begin(), states->end(),
+                               [owner](const State& state) { return state.owner == owner; });
+        if (it == states->end()) {
+            return false;
+        }
+        std::iter_swap(it, states->end() - 1);
+        State forgotten = std::move(states->back());
+        states->pop_back();
+        return true;
+    }
+};
+
+// A thread stack of `capacity` items in front of a shared list trades half a stack at a time, so
+// items cross threads in batches under one lock
+
+// Moves the older half of `stack` to `give(first, last)`, which must not touch `stack`
+template <typename T, typename Give>
+void SpillHalf(std::vector<T>& stack, Give&& give) noexcept {
+    const size_t count = std::max<size_t>(stack.size() / 2, 1);
+    give(stack.data(), stack.data() + count);
+    stack.erase(stack.begin(), stack.begin() + count);
+}
+
+// Moves up to half a stack from the back of `shared`: the newest items, which are the likeliest
+// to be in cache
+template <typename T>
+void RefillHalf(std::vector<T>& stack, std::vector<T>& shared, size_t capacity) {
+    const size_t count = std::min(shared.size(), std::max<size_t>(capacity / 2, 1));
+    stack.insert(stack.end(), shared.end() - count, shared.end());
+    shared.resize(shared.size() - count);
+}
+
+}  // namespace detail
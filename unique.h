@@ -1,10 +1,44 @@
 #pragma once
 
+#include "release_sink.h"
+
 #include <cstddef>  // std::nullptr_t
 #include <utility>
 #include <memory>
 #include <type_traits>
 
+namespace detail {
+
+// A stateful deleter can't be made again later, so a copy of it travels with the pointer in the
+// deferred release. Iterative destruction needs this to defer every node of a chain; other types
+// keep calling such deleters in place. False if there is no sink, or no memory for the entry.
+template <typename T, typename Deleter>
+bool DeferDelete(T* ptr, const Deleter& deleter) noexcept {
+    struct Entry {
+        T* ptr;
+        Deleter deleter;
+    };
+    ReleaseSink* sink = ReleaseSink::Current();
+    if (!sink) {
+        return false;
+    }
+    Entry* entry;
+    try {
+        entry = new Entry{ptr, deleter};
+    } catch (...) {
+        return false;
+    }
+    ReleaseSink::Release release = [](void* object) noexcept {
+        auto* entry = static_cast<Entry*>(object);
+        entry->deleter(entry->ptr);
+        delete entry;
+    };
+    sink->Defer(entry, release, reinterpret_cast<const void*>(release));
+    return true;
+}
+
+}  // namespace detail
+
 // Primary template
 template <typename T, typename Deleter = std::default_delete<T>>
 class UniquePtr {
@@ -42,7 +76,7 @@ public:
 
     ~UniquePtr() {
         if (raw_ptr_) {
-            GetDeleter()(std::move(raw_ptr_));
+            Destroy(raw_ptr_);
             raw_ptr_ = nullptr;
         }
     }
@@ -58,7 +92,7 @@ public:
     void Reset(T* ptr = nullptr) {
         std::swap(raw_ptr_, ptr);
         if (ptr) {
-            GetDeleter()(std::move(ptr));
+            Destroy(ptr);
         }
     }
     void Swap(UniquePtr& other) {
@@ -86,14 +120,10 @@ public:
     // Single-object dereference operators
 
     std::add_lvalue_reference_t<T> operator*() const {
-        if (Get()) {
-            return *Get();
-        }
+        return *Get();
     }
     T* operator->() const {
-        if (Get()) {
-            return Get();
-        }
+        return Get();
     }
 
     // Ban copying
@@ -102,6 +132,33 @@ public:
     UniquePtr(const UniquePtr&) = delete;
 
 private:
+    // Stateless deleters can run later, so they go to the thread's `ReleaseSink` if there is one;
+    // stateful ones too for iterative destruction (see `detail::DeferDelete`)
+    void Destroy(T* ptr) {
+        if constexpr (kIterativeDestruction<T>) {
+            if (!detail::ReleaseSink::Current()) {
+                detail::ReleaseWorklist worklist;
+                Destroy(ptr);
+                return;
+            }
+        }
+        if constexpr (std::is_empty_v<Deleter> && std::is_default_constructible_v<Deleter>) {
+            if (detail::ReleaseSink* sink = detail::ReleaseSink::Current()) {
+                detail::ReleaseSink::Release release = [](void* object) noexcept {
+                    Deleter()(static_cast<T*>(object));
+                };
+                sink->Defer(const_cast<std::remove_cv_t<T>*>(ptr), release,
+                            reinterpret_cast<const void*>(release));
+                return;
+            }
+        } else if constexpr (kIterativeDestruction<T>) {
+            if (detail::DeferDelete(ptr, GetDeleter())) {
+                return;
+            }
+        }
+        GetDeleter()(std::move(ptr));
+    }
+
     T* raw_ptr_;
     [[no_unique_address]] Deleter del_;
 };
@@ -150,7 +207,7 @@ public:
 
     ~UniquePtr() {
         if (raw_ptr_) {
-            GetDeleter()(std::move(raw_ptr_));
+            Destroy(raw_ptr_);
             raw_ptr_ = nullptr;
         }
     }
@@ -166,12 +223,12 @@ public:
     void Reset(T* ptr = nullptr) {
         std::swap(raw_ptr_, ptr);
         if (ptr) {
-            GetDeleter()(std::move(ptr));
+            Destroy(ptr);
         }
     }
     void Swap(UniquePtr& other) {
-        std::swap(this->raw_ptr_, other->raw_ptr_);
-        std::swap(this->del_, other->del_);
+        std::swap(this->raw_ptr_, other.raw_ptr_);
+        std::swap(this->del_, other.del_);
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -191,23 +248,17 @@ public:
     }
 
     std::add_lvalue_reference_t<T> operator[](size_t i) const {
-        if (Get()) {
-            return Get()[i];
-        }
+        return Get()[i];
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Single-object dereference operators
 
     std::add_lvalue_reference_t<T> operator*() const {
-        if (Get()) {
-            return *Get();
-        }
+        return *Get();
     }
     T* operator->() const {
-        if (Get()) {
-            return Get();
-        }
+        return Get();
     }
 
     // Ban copying
@@ -216,6 +267,33 @@ public:
     UniquePtr(const UniquePtr&) = delete;
 
 private:
+    // Stateless deleters can run later, so they go to the thread's `ReleaseSink` if there is one;
+    // stateful ones too for iterative destruction (see `detail::DeferDelete`)
+    void Destroy(T* ptr) {
+        if constexpr (kIterativeDestruction<T>) {
+            if (!detail::ReleaseSink::Current()) {
+                detail::ReleaseWorklist worklist;
+                Destroy(ptr);
+                return;
+            }
+        }
+        if constexpr (std::is_empty_v<Deleter> && std::is_default_constructible_v<Deleter>) {
+            if (detail::ReleaseSink* sink = detail::ReleaseSink::Current()) {
+                detail::ReleaseSink::Release release = [](void* object) noexcept {
+                    Deleter()(static_cast<T*>(object));
+                };
+                sink->Defer(const_cast<std::remove_cv_t<T>*>(ptr), release,
+                            reinterpret_cast<const void*>(release));
+                return;
+            }
+        } else if constexpr (kIterativeDestruction<T>) {
+            if (detail::DeferDelete(ptr, GetDeleter())) {
+                return;
+            }
+        }
+        GetDeleter()(std::move(ptr));
+    }
+
     T* raw_ptr_;
     [[no_unique_address]] Deleter del_;
 };
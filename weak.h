@@ -0,0 +1,153 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "shared.h"
+
+#include <cstddef>  // std::nullptr_t
+#include <utility>
+
+template <typename T, typename Counting>
+class WeakPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    WeakPtr() : raw_ptr_(nullptr) {
+    }
+
+    WeakPtr(const WeakPtr& other) noexcept {
+        Acquire(other.p_ctrl_block_, other.raw_ptr_);
+    }
+
+    template <typename Y>
+    WeakPtr(const WeakPtr<Y, Counting>& other) noexcept {
+        Acquire(other.p_ctrl_block_, other.raw_ptr_);
+    }
+
+    WeakPtr(WeakPtr&& other) noexcept {
+        p_ctrl_block_ = other.p_ctrl_block_;
+        raw_ptr_ = other.raw_ptr_;
+        other.p_ctrl_block_ = nullptr;
+        other.raw_ptr_ = nullptr;
+    }
+
+    template <typename Y>
+    WeakPtr(WeakPtr<Y, Counting>&& other) noexcept {
+        p_ctrl_block_ = other.p_ctrl_block_;
+        raw_ptr_ = other.raw_ptr_;
+        other.p_ctrl_block_ = nullptr;
+        other.raw_ptr_ = nullptr;
+    }
+
+    // Demote `SharedPtr`
+    // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
+    template <typename Y>
+    WeakPtr(const SharedPtr<Y, Counting>& other) noexcept {
+        Acquire(other.p_ctrl_block_, other.raw_ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    WeakPtr& operator=(const WeakPtr& other) noexcept {
+        WeakPtr(other).Swap(*this);
+        return *this;
+    }
+
+    template <typename Y>
+    WeakPtr& operator=(const WeakPtr<Y, Counting>& other) noexcept {
+        WeakPtr(other).Swap(*this);
+        return *this;
+    }
+
+    WeakPtr& operator=(WeakPtr&& other) noexcept {
+        WeakPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    template <typename Y>
+    WeakPtr& operator=(const SharedPtr<Y, Counting>& other) noexcept {
+        WeakPtr(other).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~WeakPtr() {
+        if (p_ctrl_block_) {
+            p_ctrl_block_->DecrWeakCount();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() noexcept {
+        WeakPtr().Swap(*this);
+    }
+
+    void Swap(WeakPtr& other) noexcept {
+        std::swap(p_ctrl_block_, other.p_ctrl_block_);
+        std::swap(raw_ptr_, other.raw_ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t UseCount() const {
+        if (!p_ctrl_block_) {
+            return 0;
+        } else {
+            return p_ctrl_block_->GetSharedCount();
+        }
+    }
+    bool Expired() const {
+        return UseCount() == 0;
+    }
+
+    // Throws `BadWeakPtr` once the object is gone
+    SharedPtr<T, Counting> Lock() const {
+        return SharedPtr<T, Counting>(*this);
+    }
+
+    // Same as `Lock()`, but an expired pointer yields an empty `SharedPtr`
+    SharedPtr<T, Counting> TryLock() const noexcept {
+        SharedPtr<T, Counting> result;
+        if (p_ctrl_block_ && p_ctrl_block_->TryIncrSharedCount()) {
+            result.p_ctrl_block_ = p_ctrl_block_;
+            result.raw_ptr_ = raw_ptr_;
+        }
+        return result;
+    }
+
+    template <typename Y, typename C>
+    friend class WeakPtr;
+
+    template <typename Y, typename C>
+    friend class SharedPtr;
+
+    template <typename V>
+    friend class detail::AtomicSlot;
+
+private:
+    void Acquire(ControlBlockBase<Counting>* p_ctrl_block, T* ptr) noexcept {
+        p_ctrl_block_ = p_ctrl_block;
+        raw_ptr_ = ptr;
+        if (p_ctrl_block_) {
+            p_ctrl_block_->IncrWeakCount();
+        }
+    }
+
+    ControlBlockBase<Counting>* p_ctrl_block_ = nullptr;
+    T* raw_ptr_;
+};
+
+template <typename T, typename Counting>
+SharedPtr<T, Counting>::SharedPtr(const WeakPtr<T, Counting>& other) {
+    if (!other.p_ctrl_block_ || !other.p_ctrl_block_->TryIncrSharedCount()) {
+        throw BadWeakPtr();
+    }
+    p_ctrl_block_ = other.p_ctrl_block_;
+    raw_ptr_ = other.raw_ptr_;
+}